@@ -0,0 +1,122 @@
+// Size and encoding cost of the negotiated response formats over a page of
+// document metadata, as GET /documents/search and /authors/{id}/documents
+// return it, and over a page of full documents with their content.
+//
+//   response_encoder_benchmark [iterations] [page size]
+
+#include <server/response_encoder.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using json = nlohmann::json;
+
+    std::string words(std::mt19937 &random, std::size_t count)
+    {
+        const std::vector<std::string> vocabulary = {"quarterly", "report", "draft", "notes", "meeting", "plan", "review", "naïve", "café", "日本", "roadmap", "budget"};
+        std::string text;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            if (i > 0)
+            {
+                text += ' ';
+            }
+            text += vocabulary[random() % vocabulary.size()];
+        }
+        return text;
+    }
+
+    // Same members as DocumentController::documentMetadataToJson
+    json metadata(std::mt19937 &random, int id)
+    {
+        long long created = 1700000000 + static_cast<long long>(random() % 10000000);
+        return json{
+            {"id", id},
+            {"title", words(random, 2 + random() % 5)},
+            {"author_id", static_cast<int>(1 + random() % 500)},
+            {"created_at", created},
+            {"updated_at", created + static_cast<long long>(random() % 1000000)},
+            {"is_public", random() % 2 == 0},
+            {"version", static_cast<int>(1 + random() % 40)}};
+    }
+
+    json page(std::size_t size, bool withContent)
+    {
+        std::mt19937 random(42);
+        json documents = json::array();
+        for (std::size_t i = 0; i < size; i++)
+        {
+            json doc = metadata(random, static_cast<int>(1000 + i));
+            if (withContent)
+            {
+                doc["content"] = words(random, 200 + random() % 400);
+            }
+            documents.push_back(std::move(doc));
+        }
+        return json{{"documents", documents}, {"next_cursor", "eyJpZCI6MTEyMCwidXBkYXRlZF9hdCI6MTcwMDAwMDAwMH0"}};
+    }
+
+    struct Result
+    {
+        std::size_t bytes = 0;
+        double micros = 0;
+    };
+
+    Result measure(const ResponseEncoder &encoder, const json &value, std::size_t iterations)
+    {
+        Result result;
+        std::size_t total = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; i++)
+        {
+            std::string body = encoder.encode(value);
+            total += body.size();
+            result.bytes = body.size();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        result.micros = elapsed.count() / iterations;
+        if (total == 0)
+        {
+            std::cerr << "nothing was encoded" << std::endl;
+        }
+        return result;
+    }
+
+    void report(const std::string &name, const json &value, std::size_t iterations)
+    {
+        const auto &encoders = ResponseEncoders::getInstance();
+        std::cout << name << "\n";
+        Result baseline;
+        for (const char *accept : {"application/json", "application/cbor", "application/msgpack"})
+        {
+            http::request<http::string_body> req{http::verb::get, "/api/documents/search", 11};
+            req.set(http::field::accept, accept);
+            const ResponseEncoder &encoder = encoders.negotiate(req);
+
+            Result result = measure(encoder, value, iterations);
+            if (encoders.isJson(encoder))
+            {
+                baseline = result;
+            }
+            std::cout << "  " << encoder.mediaType() << ": " << result.bytes << " bytes ("
+                      << 100.0 * result.bytes / baseline.bytes << "% of JSON), "
+                      << result.micros << " us/response, "
+                      << result.bytes / result.micros << " MB/s\n";
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    std::size_t pageSize = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+
+    report(std::to_string(pageSize) + " document metadata entries", page(pageSize, false), iterations);
+    report(std::to_string(pageSize) + " documents with content", page(pageSize, true), iterations / 10 + 1);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Random edits on a 10 MiB document: alternating 5-character inserts and
+// 3-character deletes at random positions, applied to a Rope and to a flat
+// std::string, then the cost of flattening the rope and of a snapshot copy.
+//
+//   rope_benchmark [edits] [megabytes]
+
+#include <utils/rope.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double microsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    // Mostly ASCII prose with a multibyte character every few words, so
+    // positions have to be resolved as code points
+    std::string makeDocument(std::size_t bytes)
+    {
+        const std::vector<std::string> words = {"lorem", "ipsum", "dolor", "sit", "amet", "naïve", "café", "über", "日本", "text"};
+        std::mt19937 random(42);
+        std::string text;
+        text.reserve(bytes + 16);
+        while (text.size() < bytes)
+        {
+            text += words[random() % words.size()];
+            text += ' ';
+        }
+        return text;
+    }
+
+    struct Edit
+    {
+        bool insert;
+        std::size_t position; // code points
+    };
+
+    std::vector<Edit> makeEdits(std::size_t count, std::size_t length)
+    {
+        std::mt19937 random(7);
+        std::vector<Edit> edits;
+        edits.reserve(count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            bool insert = i % 2 == 0;
+            edits.push_back({insert, random() % (length - 3)});
+            length += insert ? 5 : -3;
+        }
+        return edits;
+    }
+
+    // Byte offset of a code point, which a flat string editor has to find
+    // by scanning from the start
+    std::size_t byteOffset(const std::string &text, std::size_t position)
+    {
+        std::size_t offset = 0;
+        for (; offset < text.size(); offset++)
+        {
+            if ((static_cast<unsigned char>(text[offset]) & 0xC0) != 0x80)
+            {
+                if (position == 0)
+                {
+                    break;
+                }
+                position--;
+            }
+        }
+        return offset;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t editCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    std::size_t megabytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10;
+
+    std::string text = makeDocument(megabytes * 1024 * 1024);
+    std::size_t length = Rope::utf8Length(text);
+    auto edits = makeEdits(editCount, length);
+    const std::string inserted = "ab\xC3\xA9" "cd"; // 5 code points
+
+    auto start = Clock::now();
+    Rope rope(text);
+    double build = microsSince(start);
+
+    start = Clock::now();
+    for (const auto &edit : edits)
+    {
+        if (edit.insert)
+        {
+            rope.insert(edit.position, inserted);
+        }
+        else
+        {
+            rope.erase(edit.position, 3);
+        }
+    }
+    double ropeEdits = microsSince(start);
+
+    std::string flat = text;
+    start = Clock::now();
+    for (const auto &edit : edits)
+    {
+        std::size_t offset = byteOffset(flat, edit.position);
+        if (edit.insert)
+        {
+            flat.insert(offset, inserted);
+        }
+        else
+        {
+            flat.erase(offset, byteOffset(flat, edit.position + 3) - offset);
+        }
+    }
+    double stringEdits = microsSince(start);
+
+    start = Clock::now();
+    std::string flattened = rope.str();
+    double flatten = microsSince(start);
+
+    start = Clock::now();
+    Rope snapshot = rope;
+    double copy = microsSince(start);
+
+    if (flattened != flat || snapshot.length() != rope.length())
+    {
+        std::cerr << "rope and string disagree after the edits" << std::endl;
+        return 1;
+    }
+
+    std::cout << text.size() << " bytes, " << editCount << " edits\n";
+    std::cout << "rope build:       " << build / 1000 << " ms\n";
+    std::cout << "rope edit:        " << ropeEdits / editCount << " us/edit\n";
+    std::cout << "std::string edit: " << stringEdits / editCount << " us/edit\n";
+    std::cout << "rope flatten:     " << flatten / 1000 << " ms\n";
+    std::cout << "rope snapshot:    " << copy << " us\n";
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Dispatch cost of the segment trie router against the regex router it
+// replaced, over a route table shaped like the API's with 60 routes.
+//
+//   route_manager_benchmark [iterations]
+
+#include <server/route_manager.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // The previous router: an exact-match lookup, then every route's pattern
+    // compiled into a std::regex and tried in turn.
+    class RegexRouter
+    {
+    public:
+        void addRoute(const std::string &path, const std::string &method, RouteHandler handler)
+        {
+            std::string pattern = std::regex_replace(path, std::regex("\\{([^}]*)\\}"), "([^/]*)");
+            m_routes["/api" + pattern][method] = std::move(handler);
+        }
+
+        bool handleRequest(const http::request<http::string_body> &req, http::response<http::string_body> &res)
+        {
+            std::string target(req.target());
+            std::string path = target.substr(0, target.find('?'));
+            std::string method(req.method_string());
+
+            if (m_routes.count(path) > 0 && m_routes[path].count(method) > 0)
+            {
+                m_routes[path][method](req, res);
+                return true;
+            }
+
+            for (const auto &route : m_routes)
+            {
+                std::regex pattern(route.first);
+                if (std::regex_match(path, pattern) && route.second.count(method) > 0)
+                {
+                    route.second.at(method)(req, res);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        std::map<std::string, std::map<std::string, RouteHandler>> m_routes;
+    };
+
+    struct Route
+    {
+        std::string path;
+        std::string method;
+    };
+
+    std::vector<Route> routeTable()
+    {
+        std::vector<Route> routes = {
+            {"/auth/register", "POST"},
+            {"/auth/login", "POST"},
+            {"/auth/logout", "POST"},
+            {"/auth/me", "GET"},
+            {"/documents", "GET"},
+            {"/documents", "POST"},
+            {"/documents/search", "GET"},
+            {"/documents/{id}", "GET"},
+            {"/documents/{id}", "PUT"},
+            {"/documents/{id}", "PATCH"},
+            {"/documents/{id}", "DELETE"},
+            {"/documents/{id}/versions", "GET"},
+            {"/documents/{id}/versions/{version}", "GET"},
+            {"/authors/{id}", "GET"},
+            {"/authors/{id}/documents", "GET"},
+        };
+
+        // Pad the table out with resources of the same shape
+        const char *resources[] = {"folders", "tags", "comments", "shares", "templates", "webhooks", "teams", "exports", "imports"};
+        for (const char *resource : resources)
+        {
+            std::string base = std::string("/") + resource;
+            routes.push_back({base, "GET"});
+            routes.push_back({base + "/{id}", "GET"});
+            routes.push_back({base + "/{id}", "PUT"});
+            routes.push_back({base + "/{id}", "DELETE"});
+            routes.push_back({base + "/{id}/items/{item}", "GET"});
+        }
+        return routes;
+    }
+
+    std::vector<http::request<http::string_body>> requests()
+    {
+        std::vector<std::pair<http::verb, std::string>> targets = {
+            {http::verb::get, "/api/documents/42"},
+            {http::verb::put, "/api/documents/42"},
+            {http::verb::get, "/api/documents/search?q=rope&limit=20"},
+            {http::verb::get, "/api/auth/me"},
+            {http::verb::post, "/api/auth/login"},
+            {http::verb::get, "/api/documents/42/versions/7"},
+            {http::verb::get, "/api/authors/3/documents?page=2"},
+            {http::verb::get, "/api/webhooks/9/items/12"},
+            {http::verb::delete_, "/api/imports/5"},
+            {http::verb::get, "/api/missing/route"},
+        };
+
+        std::vector<http::request<http::string_body>> result;
+        for (const auto &[method, target] : targets)
+        {
+            http::request<http::string_body> req{method, target, 11};
+            result.push_back(std::move(req));
+        }
+        return result;
+    }
+
+    template <typename Dispatch>
+    double nanosPerRequest(const std::vector<http::request<http::string_body>> &reqs, size_t iterations, Dispatch dispatch)
+    {
+        http::response<http::string_body> res;
+        size_t handled = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            handled += dispatch(reqs[i % reqs.size()], res) ? 1 : 0;
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        if (handled == 0)
+        {
+            std::cerr << "no request was routed" << std::endl;
+        }
+        return elapsed.count() / iterations;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    auto routes = routeTable();
+    auto reqs = requests();
+    size_t dispatched = 0;
+
+    RegexRouter regexRouter;
+    for (const auto &route : routes)
+    {
+        regexRouter.addRoute(route.path, route.method, [&dispatched](const auto &, auto &)
+                             { dispatched++; });
+        RouteManager::addRoute(route.path, route.method, ParamRouteHandler(
+                                                             [&dispatched](const auto &, auto &, const RouteParams &)
+                                                             { dispatched++; }));
+    }
+
+    // The regex router is orders of magnitude slower; keep its run short
+    size_t regexIterations = std::max<size_t>(iterations / 100, reqs.size());
+    double regex = nanosPerRequest(reqs, regexIterations, [&regexRouter](const auto &req, auto &res)
+                                   { return regexRouter.handleRequest(req, res); });
+    double trie = nanosPerRequest(reqs, iterations, [](const auto &req, auto &res)
+                                  { return RouteManager::handleRequest(req, res); });
+
+    std::cout << routes.size() << " routes, " << reqs.size() << " request shapes\n";
+    std::cout << "regex router: " << regex << " ns/request\n";
+    std::cout << "trie router:  " << trie << " ns/request\n";
+    std::cout << "speedup:      " << regex / trie << "x\n";
+    return dispatched == 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <nlohmann/json.hpp>
 #include <string>
+#include <optional>
 #include <utils/jwtManger.hpp>
 
 using json = nlohmann::json;
@@ -10,12 +11,16 @@ class AuthController
 public:
     AuthController() = default;
 
-    json registerUser(const json &userData);
+    json registerUser(const std::string &name, const std::string &email, const std::string &password);
 
-    json loginUser(const json &userData);
+    json loginUser(const std::string &email, const std::string &password);
 
     json me(const std::string &token);
 
+    // Fingerprint of what me(token) returns, without loading the profile;
+    // nullopt when the token or the user is invalid
+    std::optional<std::string> meFingerprint(const std::string &token);
+
 private:
     std::string hashPassword(const std::string &password);
 
@@ -1,6 +1,7 @@
 #pragma once
 #include <nlohmann/json.hpp>
 #include <string>
+#include <optional>
 #include <models/authors.hpp>
 
 using json = nlohmann::json;
@@ -13,6 +14,8 @@ public:
     json createAuthor(const std::string &name, const std::string &email, const std::string &password);
     json getAuthor(int id);
     json getAuthor(const std::string &email, bool send_password = false);
+    // Changes whenever getAuthor(id) would return something else
+    std::optional<std::string> getAuthorFingerprint(int id);
     json updateAuthor(int id, const json &updates);
     json deleteAuthor(int id);
     json searchAuthors(const std::string &query);
@@ -1,23 +1,58 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <models/document.hpp>
 #include <nlohmann/json.hpp>
+#include <server/response_stream.hpp>
+#include <utils/json_writer.hpp>
 
 class DocumentController {
 public:
     DocumentController();
 
     // API endpoint handlers
-    nlohmann::json createDocument(const std::string& title, const std::string& content, const std::string& owner);
+    nlohmann::json createDocument(const std::string& title, std::string_view content, const std::string& owner);
     nlohmann::json getDocument(int id);
-    nlohmann::json updateDocument(int id, const nlohmann::json& updates);
-    nlohmann::json deleteDocument(int id);
-    nlohmann::json searchDocuments(const std::string& query, int author_id);
+    // The callback receives nullptr when the document does not exist
+    void getDocumentAsync(int id, std::function<void(std::exception_ptr, std::shared_ptr<Document>)> callback);
+    // Version and updated_at for answering conditional GETs; nullopt when the
+    // document does not exist or the lookup failed
+    void getDocumentValidatorAsync(int id, std::function<void(std::exception_ptr, std::optional<DocumentValidator>)> callback);
+    // Writes only the given fields in one conditional statement and returns
+    // the new metadata. A stale expectedVersion yields an error carrying
+    // "current_version".
+    nlohmann::json updateDocument(int id, const DocumentChanges& changes, std::optional<int> expectedVersion = std::nullopt);
+    // Applies {"base_version": n, "operations": [...]}; a stale base version
+    // yields an error carrying "current_version"
+    nlohmann::json patchDocument(int id, const nlohmann::json& patch);
+    nlohmann::json deleteDocument(int id, std::optional<int> expectedVersion = std::nullopt);
+    nlohmann::json searchDocuments(const std::string& query, int author_id, int limit = 20, const std::string& cursor = "");
+    // searchDocuments written straight to JSON text
+    std::string searchDocumentsJson(const std::string& query, int author_id, int limit = 20, const std::string& cursor = "");
+    nlohmann::json getAuthorDocuments(int author_id, bool includePrivate, int limit = 20, const std::string& cursor = "");
+    // History listing (newest first) and the content of one past version
+    nlohmann::json getDocumentVersions(int id, int limit = 50, int before = 0);
+    nlohmann::json getDocumentVersion(int id, int version);
     
     static nlohmann::json documentToJson(const Document& doc);
+    // Everything but the content, for listings
+    static nlohmann::json documentMetadataToJson(const Document& doc);
+    // The same output without an intermediate DOM; content is escaped from
+    // the rope piece by piece instead of being flattened and copied
+    static void writeDocument(JsonWriter& writer, const Document& doc);
+    static void writeDocumentMetadata(JsonWriter& writer, const Document& doc);
+    // The members after content, closing the object
+    static void writeDocumentTail(JsonWriter& writer, const Document& doc);
+    // documentToJson as a stream of pieces of about getResponseChunkSize()
+    // bytes, for documents too large to buffer whole
+    static std::shared_ptr<ResponseStream> streamDocument(std::shared_ptr<const Document> doc);
 
 private:
     nlohmann::json formatDocumentResponse(const Document& doc);
     nlohmann::json formatErrorResponse(const std::string& message);
+    DocumentPage findSearchPage(const std::string& query, int author_id, int limit, const std::string& cursor);
 };
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <libpq-fe.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace net = boost::asio;
+
+using AsyncConnectHandler = std::function<void(PGconn *conn, const std::string &error)>;
+
+// Opens a libpq connection without blocking the calling thread: the handshake
+// is started with PQconnectStart and advanced with PQconnectPoll whenever the
+// io_context reports the socket ready. The handler runs on the socket's
+// executor with the connection in non-blocking mode and socket wrapping its
+// fd, or with nullptr and the reason the attempt failed or timed out.
+class AsyncConnector : public std::enable_shared_from_this<AsyncConnector>
+{
+public:
+    static void connect(net::ip::tcp::socket &socket, const std::string &connectionString,
+                        std::chrono::milliseconds timeout, AsyncConnectHandler handler);
+
+    AsyncConnector(net::ip::tcp::socket &socket, AsyncConnectHandler handler);
+
+private:
+    void start(const std::string &connectionString, std::chrono::milliseconds timeout);
+    void poll(PostgresPollingStatusType status);
+    bool watchSocket();
+    void succeed();
+    void fail(const std::string &error);
+
+    net::ip::tcp::socket &m_socket;
+    net::steady_timer m_timer;
+    AsyncConnectHandler m_handler;
+    PGconn *m_conn = nullptr;
+    bool m_timedOut = false;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <libpq-fe.h>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace net = boost::asio;
+
+// Rows returned by an asynchronous query. Owns the underlying PGresult and is
+// cheap to copy.
+class AsyncQueryResult
+{
+public:
+    AsyncQueryResult() = default;
+    explicit AsyncQueryResult(PGresult *result);
+
+    int rows() const;
+    bool empty() const { return rows() == 0; }
+    int affectedRows() const;
+
+    bool isNull(int row, const char *column) const;
+    std::string getString(int row, const char *column) const;
+    int getInt(int row, const char *column) const;
+    bool getBool(int row, const char *column) const;
+
+private:
+    int columnIndex(const char *column) const;
+
+    std::shared_ptr<PGresult> m_result;
+};
+
+using AsyncQueryCallback = std::function<void(std::exception_ptr, AsyncQueryResult)>;
+
+// Non-blocking query layer on top of libpq. Each connection runs in libpq's
+// non-blocking mode with its socket registered on the server's io_context, so
+// a single thread can keep a query in flight on every connection at once.
+// Callbacks run on the database strand and must not block.
+class AsyncDatabase
+{
+public:
+    static AsyncDatabase &getInstance()
+    {
+        static AsyncDatabase instance;
+        return instance;
+    }
+
+    void initialize(net::io_context &ioContext, size_t connectionCount = 4);
+
+    void query(std::string sql, std::vector<std::string> params, AsyncQueryCallback callback);
+
+    void shutdown();
+
+private:
+    class Connection;
+
+    struct PendingQuery
+    {
+        std::string sql;
+        std::vector<std::string> params;
+        AsyncQueryCallback callback;
+    };
+
+    AsyncDatabase() = default;
+    ~AsyncDatabase() { shutdown(); }
+
+    AsyncDatabase(const AsyncDatabase &) = delete;
+    AsyncDatabase &operator=(const AsyncDatabase &) = delete;
+
+    // The pool is only touched on the strand
+    void dispatch();
+    void lose(const std::shared_ptr<Connection> &connection);
+    void restore(const std::shared_ptr<Connection> &connection);
+
+    std::unique_ptr<net::strand<net::io_context::executor_type>> m_strand;
+    std::vector<std::shared_ptr<Connection>> m_connections;
+    std::vector<std::shared_ptr<Connection>> m_idle;
+    std::deque<PendingQuery> m_pending;
+    size_t m_connected = 0;
+    std::mutex m_mutex;
+    bool m_initialized = false;
+};
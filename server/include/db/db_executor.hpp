@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bounded worker pool for blocking model/database work. Route handlers are
+// posted here so that the HTTP I/O threads never wait on a Postgres round-trip.
+class DatabaseExecutor
+{
+public:
+    using Task = std::function<void()>;
+
+    static DatabaseExecutor &getInstance()
+    {
+        static DatabaseExecutor instance;
+        return instance;
+    }
+
+    void start(std::size_t threadCount, std::size_t queueCapacity);
+
+    // Queues a task; returns false when the queue is full or the executor is
+    // not running so the caller can shed load instead of blocking.
+    bool post(Task task);
+
+    void shutdown();
+
+private:
+    DatabaseExecutor() = default;
+    ~DatabaseExecutor() { shutdown(); }
+
+    DatabaseExecutor(const DatabaseExecutor &) = delete;
+    DatabaseExecutor &operator=(const DatabaseExecutor &) = delete;
+
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<Task> m_tasks;
+    std::size_t m_queueCapacity = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running = false;
+};
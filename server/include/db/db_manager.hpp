@@ -1,11 +1,71 @@
 #pragma once
 
 #include <pqxx/pqxx>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <mutex>
 #include <queue>
+#include <unordered_set>
+#include <vector>
 #include "config/app_config.hpp"
+#include "db/notification_listener.hpp"
+
+class DatabaseManager;
+
+// A pooled connection together with the statements already prepared on it
+struct PooledConnection
+{
+    explicit PooledConnection(const std::string &connectionString)
+        : connection(connectionString) {}
+
+    pqxx::connection connection;
+    std::unordered_set<std::string> preparedStatements;
+};
+
+// Scoped checkout of a pooled connection; hands it back to the pool when it
+// goes out of scope.
+class ConnectionLease
+{
+public:
+    ConnectionLease() = default;
+    ConnectionLease(DatabaseManager *manager, std::shared_ptr<PooledConnection> connection)
+        : m_manager(manager), m_connection(std::move(connection)) {}
+    ~ConnectionLease() { release(); }
+
+    ConnectionLease(ConnectionLease &&other) noexcept;
+    ConnectionLease &operator=(ConnectionLease &&other) noexcept;
+    ConnectionLease(const ConnectionLease &) = delete;
+    ConnectionLease &operator=(const ConnectionLease &) = delete;
+
+    pqxx::connection &operator*() const { return m_connection->connection; }
+    pqxx::connection *operator->() const { return &m_connection->connection; }
+    explicit operator bool() const { return m_connection != nullptr; }
+
+    // Prepares a registered statement on this connection the first time it
+    // is used and returns its name for exec_prepared.
+    std::string prepare(const std::string &name);
+
+    void release();
+
+private:
+    DatabaseManager *m_manager = nullptr;
+    std::shared_ptr<PooledConnection> m_connection;
+};
+
+struct PoolMetrics
+{
+    size_t maxSize = 0;
+    size_t openConnections = 0;
+    size_t inUse = 0;
+    size_t idle = 0;
+    uint64_t acquisitions = 0;
+    uint64_t timeouts = 0;
+    uint64_t totalAcquireMicros = 0;
+    uint64_t maxAcquireMicros = 0;
+};
 
 class DatabaseManager
 {
@@ -16,15 +76,31 @@ public:
         return instance;
     }
 
-    std::shared_ptr<pqxx::connection> getConnection();
+    // Waits up to the configured acquire timeout for a free connection and
+    // throws if none becomes available.
+    ConnectionLease getConnection();
+    ConnectionLease getConnection(std::chrono::milliseconds timeout);
 
-    void releaseConnection(std::shared_ptr<pqxx::connection> connection);
+    void initialize(size_t poolSize = 5, size_t maxPoolSize = 16,
+                    std::chrono::milliseconds acquireTimeout = std::chrono::milliseconds(2000));
 
-    void initialize(size_t poolSize = 5);
+    PoolMetrics getMetrics();
+
+    // Random id of this process. Pool connections publish it as the
+    // app.instance_id setting, which tags the change notifications their
+    // writes trigger.
+    const std::string &getInstanceId() const { return m_instanceId; }
+
+    // Opens a dedicated LISTEN connection whose notifications are consumed
+    // on ioContext; see NotificationListener.
+    void listen(net::io_context &ioContext, const std::vector<std::string> &channels,
+                NotificationHandler handler, std::function<void()> onReset = nullptr);
 
     void shutdown();
 
 private:
+    friend class ConnectionLease;
+
     DatabaseManager() = default;
     ~DatabaseManager() { shutdown(); }
 
@@ -32,9 +108,18 @@ private:
     DatabaseManager(const DatabaseManager &) = delete;
     DatabaseManager &operator=(const DatabaseManager &) = delete;
 
-    std::queue<std::shared_ptr<pqxx::connection>> m_connectionPool;
+    void releaseConnection(std::shared_ptr<PooledConnection> connection);
+
+    std::queue<std::shared_ptr<PooledConnection>> m_connectionPool;
     std::mutex m_mutex;
+    std::condition_variable m_available;
     bool m_initialized = false;
+    size_t m_maxPoolSize = 0;
+    size_t m_openConnections = 0;
+    std::chrono::milliseconds m_acquireTimeout{0};
+    PoolMetrics m_metrics;
+    std::shared_ptr<NotificationListener> m_listener;
+    std::string m_instanceId;
 
-    std::shared_ptr<pqxx::connection> createConnection();
-};
\ No newline at end of file
+    std::shared_ptr<PooledConnection> createConnection();
+};
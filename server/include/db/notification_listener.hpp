@@ -0,0 +1,51 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <libpq-fe.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace net = boost::asio;
+
+using NotificationHandler = std::function<void(const std::string &channel, const std::string &payload)>;
+
+// Dedicated libpq connection that LISTENs on a set of channels. Its socket is
+// watched by the io_context, so notifications are delivered on the listener's
+// strand as soon as they arrive, without polling. After the connection drops,
+// onReset runs once it is re-established since anything may have changed.
+class NotificationListener : public std::enable_shared_from_this<NotificationListener>
+{
+public:
+    NotificationListener(net::io_context &ioContext, std::string connectionString,
+                         std::vector<std::string> channels,
+                         NotificationHandler handler, std::function<void()> onReset);
+    ~NotificationListener() { close(); }
+
+    // Connects and subscribes; throws if the first attempt fails
+    void start();
+    void stop();
+
+private:
+    void connect();
+    void close();
+    std::string listenCommand();
+    void waitForNotifications();
+    void readNotifications();
+    void scheduleReconnect();
+    void reconnect();
+    void flushSubscription();
+    void readSubscription();
+
+    net::ip::tcp::socket m_socket;
+    net::steady_timer m_reconnectTimer;
+    std::string m_connectionString;
+    std::vector<std::string> m_channels;
+    NotificationHandler m_handler;
+    std::function<void()> m_onReset;
+    PGconn *m_conn = nullptr;
+    bool m_stopped = false;
+};
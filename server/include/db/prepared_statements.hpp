@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+// Central registry of the named statements used by the models. Statements are
+// prepared lazily on each pooled connection (see ConnectionLease::prepare) and
+// executed with bound parameters through exec_prepared.
+class PreparedStatements
+{
+public:
+    // documents
+    static constexpr const char *DOCUMENT_FIND_BY_ID = "document_find_by_id";
+    static constexpr const char *DOCUMENT_INSERT = "document_insert";
+    static constexpr const char *DOCUMENT_UPDATE = "document_update";
+    static constexpr const char *DOCUMENT_DELETE = "document_delete";
+    static constexpr const char *DOCUMENT_CURRENT_VERSION = "document_current_version";
+    static constexpr const char *DOCUMENT_LOCK_FOR_EDIT = "document_lock_for_edit";
+    static constexpr const char *DOCUMENT_CONTENT_SPAN = "document_content_span";
+    static constexpr const char *DOCUMENT_REPLACE_SPAN = "document_replace_span";
+    static constexpr const char *DOCUMENTS_BY_AUTHORS = "documents_by_authors";
+    static constexpr const char *DOCUMENTS_PAGE_BY_AUTHOR = "documents_page_by_author";
+    static constexpr const char *DOCUMENTS_ASSIGN_AUTHOR = "documents_assign_author";
+    static constexpr const char *DOCUMENTS_DELETE_BY_AUTHOR = "documents_delete_by_author";
+    static constexpr const char *DOCUMENT_SEARCH = "document_search";
+    static constexpr const char *DOCUMENTS_INDEX_BATCH = "documents_index_batch";
+    static constexpr const char *DOCUMENTS_INDEX_BY_IDS = "documents_index_by_ids";
+    static constexpr const char *DOCUMENT_INDEX_VERSIONS = "document_index_versions";
+
+    // document history
+    static constexpr const char *DOCUMENT_VERSION_SNAPSHOT = "document_version_snapshot";
+    static constexpr const char *DOCUMENT_VERSION_DELTA = "document_version_delta";
+    static constexpr const char *DOCUMENT_VERSION_CHAIN = "document_version_chain";
+    static constexpr const char *DOCUMENT_VERSIONS_PAGE = "document_versions_page";
+
+    // authors
+    static constexpr const char *AUTHOR_FIND_BY_ID = "author_find_by_id";
+    static constexpr const char *AUTHOR_FIND_BY_EMAIL = "author_find_by_email";
+    static constexpr const char *AUTHOR_SEARCH_BY_NAME = "author_search_by_name";
+    static constexpr const char *AUTHOR_ALL = "author_all";
+    static constexpr const char *AUTHOR_INSERT = "author_insert";
+    static constexpr const char *AUTHOR_UPDATE = "author_update";
+    static constexpr const char *AUTHOR_SOFT_DELETE = "author_soft_delete";
+    static constexpr const char *AUTHOR_PROFILE_FINGERPRINT = "author_profile_fingerprint";
+
+    // Returns the SQL registered under name; throws for unknown statements.
+    static const std::string &sql(const std::string &name);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <pqxx/pqxx>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include <utils/sqlbuilder.hpp>
+
+// Converts SQLBuilder parameters into the form exec_params expects
+inline pqxx::params toPqxxParams(const std::vector<sql_param> &values)
+{
+    pqxx::params params;
+    params.reserve(values.size());
+    for (const auto &value : values)
+    {
+        std::visit([&params](const auto &v)
+                   {
+                       using T = std::decay_t<decltype(v)>;
+                       if constexpr (std::is_same_v<T, std::nullptr_t>)
+                       {
+                           params.append();
+                       }
+                       else
+                       {
+                           params.append(v);
+                       } },
+                   value);
+    }
+    return params;
+}
+
+// Renders ids as a Postgres array literal for "= ANY($n::integer[])"
+inline std::string toPgArray(const std::vector<int> &values)
+{
+    std::string array = "{";
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (i != 0)
+        {
+            array += ",";
+        }
+        array += std::to_string(values[i]);
+    }
+    array += "}";
+    return array;
+}
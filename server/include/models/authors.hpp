@@ -3,8 +3,14 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <optional>
 #include "document.hpp"
 
+namespace pqxx
+{
+    class transaction_base;
+}
+
 class Author
 {
 private:
@@ -14,10 +20,17 @@ private:
     std::string email;    // Author email
     std::string password; // Author password
     bool is_deleted;
-    std::vector<std::shared_ptr<Document>> documents;
+    std::vector<std::shared_ptr<Document>> documents; // first page, metadata only
+    std::string documentsCursor;                      // next page, see Document::findByAuthor
+    bool documentsLoaded = false;
     void populateDocuments();
+    // Loads the first page of documents of every author in one query
+    static void loadDocuments(pqxx::transaction_base &txn, const std::string &statement,
+                              const std::vector<Author *> &authors);
 
 public:
+    static constexpr int DOCUMENTS_PAGE_SIZE = 20;
+
     Author(const std::string &name, const std::string &email, const std::string &password);
 
     // Getters
@@ -34,12 +47,19 @@ public:
     void setPassword(const std::string &newPassword);
     void setDeleted(bool status);
 
-    // Database operations
+    // Database operations. save() writes the author and makes it the owner
+    // of every document in getDocuments(); the documents' own fields are
+    // saved with Document::save, and unsaved documents make it fail.
     bool save();
     bool remove();
     static std::vector<Author> search(const std::string &query);
     static std::vector<Author> all();
     static Author findById(int id);
     static Author findByEmail(const std::string &email);
+    // Digest of everything the profile response shows (author row and first
+    // documents page) from one metadata query; nullopt for unknown authors
+    static std::optional<std::string> profileFingerprint(int id);
     const std::vector<std::shared_ptr<Document>> &getDocuments() const;
+    // Cursor for the documents after getDocuments(); empty when there are none
+    const std::string &getDocumentsCursor() const;
 };
\ No newline at end of file
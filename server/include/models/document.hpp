@@ -1,10 +1,66 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <ctime>
+#include <functional>
+#include <optional>
+#include <stdexcept>
 #include <utils/sqlbuilder.hpp>
+#include <utils/rope.hpp>
+
+struct DocumentPage;
+
+// One positional edit. Positions and lengths count characters (code points),
+// like Postgres' overlay(), and apply to the text left by the previous
+// operation in the same batch.
+struct TextOperation
+{
+    enum class Type
+    {
+        Insert,
+        Delete
+    };
+
+    Type type;
+    long long position;
+    std::string text;   // Insert
+    long long length;   // Delete
+};
+
+// Thrown when an edit names a base version that is no longer current
+class VersionConflict : public std::runtime_error
+{
+public:
+    explicit VersionConflict(int currentVersion)
+        : std::runtime_error("Document has been modified since version was read"),
+          currentVersion(currentVersion) {}
+
+    int currentVersion;
+};
+
+// Fields a client may overwrite; unset fields keep their stored value. The
+// text is not owned and must outlive the update.
+struct DocumentChanges
+{
+    std::optional<std::string_view> title;
+    std::optional<std::string_view> content;
+    std::optional<bool> isPublic;
+};
+
+// What a conditional GET compares against, without the content
+struct DocumentValidator
+{
+    int version;
+    time_t updated_at;
+};
+
+namespace pqxx
+{
+    class row;
+}
 
 class Document
 {
@@ -12,37 +68,96 @@ private:
     int id; // Unique
 
     std::string title;   // Document title
-    std::string content; // Document content
+    Rope content;        // Document content; edits share structure with copies
+    mutable std::shared_ptr<const std::string> flatContent; // lazily built from content
+    Rope savedContent;   // content as stored at version, the base for history deltas
     time_t created_at;   // Creation timestamp
     time_t updated_at;   // Last update timestamp
     bool is_public;      // Document visibility status
     int author_id;       // New field for the author relation
+    int version;         // Bumped by the database on every change
+
+    friend class SearchIndex;
+    friend class Author;
 
 public:
-    Document(const std::string &title, const std::string &content, const std::string &owner);
+    Document(const std::string &title, std::string_view content, const std::string &owner);
 
     // Getters
     int getId() const { return id; }
     std::string getTitle() const { return title; }
-    std::string getContent() const { return content; }
+    // Flattens the content on first use after an edit; copies of the
+    // document share the flattened text.
+    const std::string &getContent() const;
+    // The content without flattening it, e.g. to serialise it piecewise
+    const Rope &getContentRope() const { return content; }
+    std::size_t getContentLength() const { return content.length(); }
+    std::size_t getContentBytes() const { return content.byteSize(); }
     time_t getCreatedAt() const { return created_at; }
     time_t getUpdatedAt() const { return updated_at; }
     bool isPublic() const { return is_public; }
     int getAuthorId() const { return author_id; } // New getter for author_id
+    int getVersion() const { return version; }
 
     // Setters
     void setId(int newId) { id = newId; }
     void setTitle(const std::string &newTitle);
-    void setContent(const std::string &newContent);
+    void setContent(std::string_view newContent);
     void setPublic(bool status);
     void setAuthorId(int newAuthorId); // New setter for author_id
 
+    // In-memory edits; positions count characters. applyEdits validates the
+    // whole batch like applyOperations and leaves the document untouched if
+    // any operation is out of range.
+    void insertText(std::size_t position, const std::string &text);
+    void eraseText(std::size_t position, std::size_t length);
+    void applyEdits(const std::vector<TextOperation> &operations);
+
     // Utility methods
     void updateTimestamp();
 
-    // Database operations
+    // Database operations. Updating an existing document only succeeds while
+    // the row is still at this object's version; otherwise save() throws
+    // VersionConflict instead of overwriting someone else's edit.
     bool save();
     bool remove();
-    static std::vector<Document> search(const std::string &query, const int author_id, bool includePrivate);
+    // Single conditional UPDATE; expectedVersion (e.g. from If-Match) makes
+    // it fail with VersionConflict once the row has moved on. Throws
+    // std::runtime_error when the document does not exist. Returns the
+    // updated metadata.
+    static Document update(int id, const DocumentChanges &changes, std::optional<int> expectedVersion);
+    // Returns false when the document does not exist; VersionConflict as above
+    static bool removeById(int id, std::optional<int> expectedVersion);
+    // Ranked full-text search; cursor is the nextCursor of the previous page
+    static DocumentPage search(const std::string &query, const int author_id, bool includePrivate,
+                                     int limit = 20, const std::string &cursor = "");
     static std::shared_ptr<Document> findById(int id);
+    // Applies operations in order to the stored content without shipping the
+    // whole text, provided baseVersion is still current (VersionConflict
+    // otherwise). Returns the updated document metadata. Each operation adds
+    // a nesting level to the UPDATE, hence the cap per call.
+    static constexpr std::size_t MAX_OPERATIONS = 500;
+    static Document applyOperations(int id, int baseVersion, const std::vector<TextOperation> &operations);
+    // Newest first, metadata only; cursor is the nextCursor of the previous
+    // page. Private documents are only listed with includePrivate.
+    static DocumentPage findByAuthor(int author_id, bool includePrivate, int limit = 20, const std::string &cursor = "");
+    // Builds a document from id, title, author_id, created_at, updated_at,
+    // is_public and version; content is left empty.
+    static Document fromMetadataRow(const pqxx::row &row);
+    // Non-blocking lookup through AsyncDatabase; the callback runs on the
+    // database strand (or inline on a cache hit) and receives the query
+    // error if there was one, otherwise nullptr when the document does not
+    // exist.
+    static void findByIdAsync(int id, std::function<void(std::exception_ptr, std::shared_ptr<Document>)> callback);
+    // Version and updated_at only, from the cache or a metadata query; the
+    // callback receives the query error or nullopt when the document does
+    // not exist
+    static void findValidatorAsync(int id, std::function<void(std::exception_ptr, std::optional<DocumentValidator>)> callback);
+};
+
+// One page of a document listing or search. Content is not loaded.
+struct DocumentPage
+{
+    std::vector<Document> documents;
+    std::string nextCursor; // empty on the last page
 };
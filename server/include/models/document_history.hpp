@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <models/document.hpp>
+
+class ConnectionLease;
+
+namespace pqxx
+{
+    class transaction_base;
+}
+
+// One entry of a document's history. content is only filled in when a
+// single version is reconstructed.
+struct DocumentVersion
+{
+    int version = 0;
+    time_t created_at = 0;
+    bool isSnapshot = false;
+    std::size_t storedBytes = 0; // snapshot text or encoded delta
+    std::string content;
+};
+
+struct DocumentVersionPage
+{
+    std::vector<DocumentVersion> versions;
+    int nextBefore = 0; // pass as before for the next page; 0 on the last page
+};
+
+// Content history in document_versions. Every version is stored either as a
+// full snapshot or as a compact binary delta from the previous version, with
+// a snapshot at least every getDocumentSnapshotInterval() versions, so a
+// version is rebuilt from one snapshot and a bounded run of deltas.
+class DocumentHistory
+{
+public:
+    // Records the version the document row has just been updated to, inside
+    // the writing transaction. operations turn the previous version into this
+    // one; pass nullptr when they are unknown and a snapshot is stored.
+    static void record(ConnectionLease &conn, pqxx::transaction_base &txn, int documentId, int version,
+                       const std::vector<TextOperation> *operations);
+
+    // Newest first; before is a version number or 0 for the latest
+    static DocumentVersionPage list(int documentId, int limit = 50, int before = 0);
+    // Rebuilt content of one version, or nullopt when it is not in the history
+    static std::optional<DocumentVersion> find(int documentId, int version);
+
+    // The single replace that turns before into after, in character positions
+    static std::vector<TextOperation> diff(std::string_view before, std::string_view after);
+
+    // Varint-packed operation list; decode throws std::runtime_error on
+    // malformed input
+    static std::string encodeDelta(const std::vector<TextOperation> &operations);
+    static std::vector<TextOperation> decodeDelta(std::string_view delta);
+};
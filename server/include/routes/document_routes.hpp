@@ -1,6 +1,10 @@
 #pragma once
 #include <boost/beast/http.hpp>
 #include <controllers/document_controller.hpp>
+#include <functional>
+#include <optional>
+#include <server/route_manager.hpp>
+#include <server/response_encoder.hpp>
 
 namespace http = boost::beast::http;
 
@@ -10,12 +14,31 @@ public:
     static void registerRoutes();
 
     // Route handlers
-    static void handleGetDocument(const http::request<http::string_body> &req, http::response<http::string_body> &res);
+    static void handleGetDocument(const http::request<http::string_body> &req, http::response<http::string_body> &res, const RouteParams &params, AsyncDone done);
     static void handleCreateDocument(const http::request<http::string_body> &req, http::response<http::string_body> &res);
-    static void handleUpdateDocument(const http::request<http::string_body> &req, http::response<http::string_body> &res);
-    static void handleDeleteDocument(const http::request<http::string_body> &req, http::response<http::string_body> &res);
+    static void handleUpdateDocument(const http::request<http::string_body> &req, http::response<http::string_body> &res, const RouteParams &params);
+    static void handlePatchDocument(const http::request<http::string_body> &req, http::response<http::string_body> &res, const RouteParams &params);
+    static void handleDeleteDocument(const http::request<http::string_body> &req, http::response<http::string_body> &res, const RouteParams &params);
     static void handleSearchDocuments(const http::request<http::string_body> &req, http::response<http::string_body> &res);
+    static void handleGetDocumentVersions(const http::request<http::string_body> &req, http::response<http::string_body> &res, const RouteParams &params);
+    static void handleGetDocumentVersion(const http::request<http::string_body> &req, http::response<http::string_body> &res, const RouteParams &params);
+    static void handleGetAuthorDocuments(const http::request<http::string_body> &req, http::response<http::string_body> &res, const RouteParams &params);
 
 private:
     static DocumentController documentController;
+
+    // Document id from the /documents/{id} path, or the legacy ?id= parameter
+    static int documentId(const http::request<http::string_body> &req, const RouteParams &params);
+    // Loads the document and writes it as a 200 with its validators
+    static void sendDocument(int id, const ResponseEncoder &encoder, http::response<http::string_body> &res, AsyncDone done);
+    // 500 for a lookup that failed, as opposed to one that found nothing
+    static void sendLoadFailure(const ResponseEncoder &encoder, http::response<http::string_body> &res, const AsyncDone &done);
+    // Author id from a valid token cookie, nullopt for anonymous requests
+    static std::optional<int> requestAuthorId(const http::request<http::string_body> &req);
+    // Status of a PUT or DELETE from the controller's result: 412 for a
+    // stale or unmatched If-Match, 404 for a missing document, 500 for
+    // other failures
+    static http::status writeStatus(const http::request<http::string_body> &req, const nlohmann::json &result);
+    // ETag for a response describing a document (id and version present)
+    static void setEtag(http::response<http::string_body> &res, const nlohmann::json &document, const ResponseEncoder &encoder);
 };
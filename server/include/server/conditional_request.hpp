@@ -0,0 +1,49 @@
+#pragma once
+#include <boost/beast/http.hpp>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace http = boost::beast::http;
+
+// HTTP validators for versioned resources. A document's strong ETag is
+// "<id>-<version>"; the version changes with every write, so comparing tags
+// never needs the content. Formats other than JSON append "+<variant>" (see
+// ResponseEncoder::tagSuffix) so each representation has its own tag.
+class ConditionalRequest
+{
+public:
+    static std::string etag(int id, int version, std::string_view variant = {});
+    // Strong ETag from an opaque fingerprint of a resource's state
+    static std::string etag(std::string_view fingerprint, std::string_view variant = {});
+
+    // The version If-Match requires of resource id: nullopt when there is no
+    // precondition (header absent or "*"), -1 when none of the listed tags
+    // belongs to id so that no version can match. Weak tags never match.
+    static std::optional<int> ifMatchVersion(const http::request<http::string_body> &req, int id);
+
+    // True when the request carries If-None-Match or If-Modified-Since
+    static bool isConditional(const http::request<http::string_body> &req);
+    // True when the client's copy is current and a GET can be answered with
+    // 304. If-None-Match uses the weak comparison and, when present, takes
+    // precedence over If-Modified-Since, which is ignored without a
+    // lastModified or when its date does not parse.
+    static bool notModified(const http::request<http::string_body> &req, std::string_view etag,
+                            std::optional<time_t> lastModified);
+    // Sets ETag and Last-Modified and turns res into an empty 304
+    static void setNotModified(http::response<http::string_body> &res, std::string_view etag,
+                               std::optional<time_t> lastModified);
+
+    // IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+    static std::string httpDate(time_t time);
+    static std::optional<time_t> parseHttpDate(std::string_view date);
+
+private:
+    // Version from a quoted "<id>-<version>[+<variant>]" tag of resource id,
+    // if it is one
+    static std::optional<int> parseTag(std::string_view tag, int id);
+    // Splits a comma-separated list of entity tags, trimming whitespace
+    template <typename Visitor>
+    static bool forEachTag(std::string_view value, Visitor &&visit);
+};
@@ -3,7 +3,10 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <deque>
 #include <memory>
+#include <optional>
+#include <server/response_stream.hpp>
 #include <thread>
 #include <vector>
 
@@ -18,7 +21,9 @@ public:
     HttpServer(
         net::io_context &io_context,
         unsigned short port,
-        unsigned int thread_count = std::thread::hardware_concurrency());
+        unsigned int thread_count = std::thread::hardware_concurrency(),
+        bool shard_per_thread = false,
+        bool pin_threads = false);
 
     void run();
     void stop();
@@ -27,10 +32,32 @@ private:
     class HttpSession : public std::enable_shared_from_this<HttpSession>
     {
     private:
-        tcp::socket socket_;
+        // A parsed request and the response produced for it. Exchanges are
+        // queued in arrival order so pipelined responses are written in order.
+        struct Exchange
+        {
+            http::request<http::string_body> request;
+            http::response<http::string_body> response;
+            bool ready = false;
+
+            // Streamed responses: response only supplies the headers and the
+            // body goes out in chunks, one piece in memory at a time
+            std::shared_ptr<ResponseStream> stream;
+            std::optional<http::response<http::empty_body>> stream_header;
+            std::optional<http::response_serializer<http::empty_body>> stream_serializer;
+            std::string chunk;
+        };
+
+        beast::tcp_stream stream_;
         beast::flat_buffer buffer_;
-        http::request<http::string_body> request_;
-        http::response<http::string_body> response_;
+        std::optional<http::request_parser<http::string_body>> parser_;
+        std::deque<std::shared_ptr<Exchange>> pipeline_;
+        bool reading_ = false;
+        bool writing_ = false;
+        bool closing_ = false;
+        // A WebSocket upgrade waiting for the responses queued before it
+        std::optional<http::request<http::string_body>> upgrade_;
+        int upgrade_document_id_ = -1;
 
     public:
         // Updated constructor to take socket by move
@@ -40,16 +67,35 @@ private:
 
     private:
         void read_request();
-        void process_request();
-        void handle_health_check();
-        void handle_not_found();
+        void on_read_header(beast::error_code ec);
+        void on_read(beast::error_code ec);
+        void process_request(const std::shared_ptr<Exchange> &exchange);
+        void complete_request(Exchange &exchange, bool handled, std::shared_ptr<ResponseStream> stream = nullptr);
+        void handle_health_check(Exchange &exchange);
+        void handle_not_found(Exchange &exchange);
+        void handle_service_unavailable(Exchange &exchange);
+        void handle_payload_too_large(Exchange &exchange);
         void write_response();
+        void write_stream(const std::shared_ptr<Exchange> &exchange);
+        void write_chunk(const std::shared_ptr<Exchange> &exchange);
+        void on_write(beast::error_code ec, bool close);
+        void arm_idle_deadline();
+        void start_upgrade();
+        void do_close();
     };
 
     net::io_context &io_context_;
-    tcp::acceptor acceptor_;
+    // In sharded mode io_context_ serves the first thread and every further
+    // thread gets its own context; sessions never leave the accepting thread.
+    std::vector<std::unique_ptr<net::io_context>> shard_contexts_;
+    std::vector<std::unique_ptr<tcp::acceptor>> acceptors_;
     unsigned int thread_count_;
+    bool shard_per_thread_;
+    bool pin_threads_;
     std::vector<std::thread> worker_threads_;
 
-    void do_accept();
+    net::io_context &context_for_thread(unsigned int index);
+    void open_acceptor(net::io_context &io_context, const tcp::endpoint &endpoint, bool reuse_port);
+    void do_accept(tcp::acceptor &acceptor);
+    static void pin_thread(unsigned int cpu);
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only view over the query component of a request target. Parameters are
+// split once into a small inline table of string_views; values are only
+// URL-decoded (and only allocate) when they actually contain escapes.
+// The viewed target must outlive the QueryString.
+class QueryString
+{
+public:
+    static constexpr std::size_t inline_capacity = 16;
+
+    // Parses everything after the '?' of a request target ("/path?a=1")
+    explicit QueryString(std::string_view target);
+
+    bool contains(std::string_view key) const;
+    std::size_t size() const { return m_size + m_overflow.size(); }
+
+    // Undecoded value of the first parameter named key
+    std::optional<std::string_view> raw(std::string_view key) const;
+
+    // Decoded, typed value; throws std::invalid_argument when the parameter
+    // is missing or can't be converted to T.
+    template <typename T>
+    T get(std::string_view key) const;
+
+    // As above, but returns fallback when the parameter is missing
+    template <typename T>
+    T get(std::string_view key, T fallback) const
+    {
+        return contains(key) ? get<T>(key) : fallback;
+    }
+
+    // Percent-decodes value, treating '+' as a space
+    static std::string decode(std::string_view value);
+
+private:
+    struct Entry
+    {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    void add(std::string_view key, std::string_view value);
+    const Entry *find(std::string_view key) const;
+    std::string_view required(std::string_view key) const;
+
+    std::array<Entry, inline_capacity> m_entries{};
+    std::size_t m_size = 0;
+    // Only used by requests with more than inline_capacity parameters
+    std::vector<Entry> m_overflow;
+};
+
+template <>
+std::string QueryString::get<std::string>(std::string_view key) const;
+template <>
+int QueryString::get<int>(std::string_view key) const;
+template <>
+long long QueryString::get<long long>(std::string_view key) const;
+template <>
+bool QueryString::get<bool>(std::string_view key) const;
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <models/document.hpp>
+
+struct CreateDocumentRequest
+{
+    std::string_view title;
+    std::string_view content;
+    std::string_view owner;
+};
+
+struct RegistrationRequest
+{
+    std::string_view name;
+    std::string_view email;
+    std::string_view password;
+};
+
+struct LoginRequest
+{
+    std::string_view email;
+    std::string_view password;
+};
+
+// Bodies of the document and auth endpoints, parsed with simdjson's
+// on-demand API: UTF-8 is validated in the same SIMD pass that indexes the
+// structure, and only the expected fields are decoded. String fields are
+// views into body when they contain no escapes, which is the usual case for
+// large content, and into this thread's parser otherwise, so they stay valid
+// until body changes or the thread parses the next body. Malformed bodies,
+// unknown field types and missing required fields throw
+// std::invalid_argument; unknown fields are ignored.
+class RequestBody
+{
+public:
+    // Spare capacity after the body that lets it be parsed in place;
+    // HttpSession reserves it, other bodies are copied once into a buffer
+    static constexpr std::size_t PADDING = 64;
+
+    static CreateDocumentRequest parseCreateDocument(const std::string &body);
+    // title, content and is_public, each optional
+    static DocumentChanges parseDocumentChanges(const std::string &body);
+    static RegistrationRequest parseRegistration(const std::string &body);
+    static LoginRequest parseLogin(const std::string &body);
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <boost/beast/http.hpp>
+#include <nlohmann/json.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http = boost::beast::http;
+
+// Turns a controller result into the bytes of one wire format
+class ResponseEncoder
+{
+public:
+    virtual ~ResponseEncoder() = default;
+
+    // Sent as Content-Type and matched against Accept
+    virtual std::string_view mediaType() const = 0;
+    // Appended to ETags so that every format of a resource has its own
+    // strong validator; empty for JSON, whose tags predate negotiation
+    virtual std::string_view tagSuffix() const = 0;
+    virtual std::string encode(const nlohmann::json &value) const = 0;
+};
+
+// The formats a response can be negotiated into through Accept. JSON is the
+// default and always first; CBOR and MessagePack are built in, and further
+// formats can be added at startup, before the server takes requests.
+class ResponseEncoders
+{
+public:
+    static ResponseEncoders &getInstance()
+    {
+        static ResponseEncoders instance;
+        return instance;
+    }
+
+    // aliases are further media types that select the encoder
+    void add(std::shared_ptr<const ResponseEncoder> encoder, std::vector<std::string> aliases = {});
+
+    // The encoder with the highest q-value in Accept, the earlier registered
+    // one on ties; JSON when Accept is absent or names none of them
+    const ResponseEncoder &negotiate(const http::request<http::string_body> &req) const;
+    const ResponseEncoder &json() const { return *m_entries.front().encoder; }
+    bool isJson(const ResponseEncoder &encoder) const { return &encoder == &json(); }
+
+    // Sets Content-Type, Vary and the body of res to value in encoder's format
+    static void write(const ResponseEncoder &encoder, http::response<http::string_body> &res, const nlohmann::json &value);
+    // The same with the encoder negotiated for req
+    static void write(const http::request<http::string_body> &req, http::response<http::string_body> &res, const nlohmann::json &value);
+
+private:
+    ResponseEncoders();
+
+    ResponseEncoders(const ResponseEncoders &) = delete;
+    ResponseEncoders &operator=(const ResponseEncoders &) = delete;
+
+    struct Entry
+    {
+        std::shared_ptr<const ResponseEncoder> encoder;
+        std::vector<std::string> mediaTypes; // lower case
+    };
+
+    // q-value of the most specific range in accept that covers mediaType
+    static double quality(std::string_view accept, std::string_view mediaType);
+
+    std::vector<Entry> m_entries;
+};
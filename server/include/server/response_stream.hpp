@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+// A response body produced piece by piece after the headers have been
+// written, sent with chunked transfer encoding. HttpSession asks for the next
+// piece only once the previous one is on the wire, so a large body never has
+// to exist in memory as a whole.
+class ResponseStream
+{
+public:
+    virtual ~ResponseStream() = default;
+
+    // Replaces out with the next piece of the body; false once it is complete
+    virtual bool next(std::string &out) = 0;
+};
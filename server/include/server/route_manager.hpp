@@ -1,27 +1,82 @@
 #pragma once
 #include <boost/beast/http.hpp>
+#include <server/response_stream.hpp>
+#include <array>
+#include <cstddef>
 #include <functional>
-#include <map>
+#include <memory>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace http = boost::beast::http;
 
+// Path parameters captured while matching a route, e.g. {id} in
+// /documents/{id}. Names point into the route table and values into the
+// request target, so nothing is copied during dispatch.
+class RouteParams
+{
+public:
+    static constexpr std::size_t capacity = 8;
+
+    bool add(std::string_view name, std::string_view value);
+    void truncate(std::size_t size) { m_size = size; }
+
+    // Returns an empty view when the parameter is missing
+    std::string_view get(std::string_view name) const;
+    bool contains(std::string_view name) const;
+    std::size_t size() const { return m_size; }
+
+private:
+    std::array<std::pair<std::string_view, std::string_view>, capacity> m_params{};
+    std::size_t m_size = 0;
+};
+
 using RouteHandler = std::function<void(const http::request<http::string_body> &, http::response<http::string_body> &)>;
-using QueryParams = std::map<std::string, std::string>;
+using ParamRouteHandler = std::function<void(const http::request<http::string_body> &, http::response<http::string_body> &, const RouteParams &)>;
+// Completes an asynchronous response. Pass nullptr when the body is in the
+// response, or a stream that produces it after the headers.
+using AsyncDone = std::function<void(std::shared_ptr<ResponseStream> stream)>;
+// Non-blocking handler: runs on the I/O thread and calls done() once the
+// response has been filled in, from whichever thread finished the work.
+using AsyncRouteHandler = std::function<void(const http::request<http::string_body> &, http::response<http::string_body> &, const RouteParams &, AsyncDone done)>;
 
 class RouteManager
 {
 public:
     static void addRoute(const std::string &path, const std::string &method, RouteHandler handler);
+    static void addRoute(const std::string &path, const std::string &method, ParamRouteHandler handler);
+    static void addAsyncRoute(const std::string &path, const std::string &method, AsyncRouteHandler handler);
     static bool handleRequest(
         const http::request<http::string_body> &req,
         http::response<http::string_body> &res);
-
-    static QueryParams parseQueryParameters(const std::string &queryString);
-    static std::pair<std::string, std::string> splitPathAndQuery(const std::string &target);
+    static bool handleRequestAsync(
+        const http::request<http::string_body> &req,
+        http::response<http::string_body> &res,
+        AsyncDone done);
 
 private:
-    static std::map<std::string, std::map<std::string, RouteHandler>> routes;
-    static std::string extractPathParam(const std::string &path, const std::string &pattern);
+    struct RouteEntry
+    {
+        http::verb method;
+        ParamRouteHandler handler;
+        AsyncRouteHandler asyncHandler;
+    };
+
+    // One path segment of the route trie. Static children are kept sorted so
+    // lookups are a binary search; a {param} child matches any segment.
+    struct RouteNode
+    {
+        std::vector<std::pair<std::string, std::unique_ptr<RouteNode>>> children;
+        std::unique_ptr<RouteNode> paramChild;
+        std::string paramName;
+        std::vector<RouteEntry> entries;
+    };
+
+    static RouteNode root;
+
+    static RouteEntry &insert(const std::string &path, const std::string &method);
+    static const RouteEntry *find(const http::request<http::string_body> &req, RouteParams &params);
+    static const RouteEntry *match(const RouteNode &node, std::string_view path, http::verb method, RouteParams &params);
 };
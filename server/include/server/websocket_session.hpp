@@ -0,0 +1,52 @@
+#pragma once
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <deque>
+#include <memory>
+#include <string>
+#include <services/collaboration.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+
+// A WebSocket connection upgraded from an HttpSession and attached to the
+// collaboration room of one document. Messages are JSON text frames; see
+// CollaborationRoom for the protocol. Everything runs on the executor the
+// HTTP session already used, and outgoing messages are queued because the
+// room sends from its own strand.
+class WebSocketSession : public CollaborationClient,
+                         public std::enable_shared_from_this<WebSocketSession>
+{
+public:
+    WebSocketSession(beast::tcp_stream &&stream, int document_id);
+
+    // Completes the handshake for the already parsed upgrade request
+    void start(http::request<http::string_body> request);
+
+    void send(std::shared_ptr<const std::string> message) override;
+    void close() override;
+
+    // Returns the document id for /documents/{id}/collaborate, or -1
+    static int collaboration_target(beast::string_view target);
+
+private:
+    void on_accept(beast::error_code ec);
+    void read_message();
+    void on_read(beast::error_code ec);
+    void handle_message(const std::string &text);
+    void write_message();
+    void on_write(beast::error_code ec);
+    void do_close();
+    void drop_queued();
+    void leave_room();
+
+    websocket::stream<beast::tcp_stream> ws_;
+    beast::flat_buffer buffer_;
+    std::deque<std::shared_ptr<const std::string>> queue_;
+    std::shared_ptr<CollaborationRoom> room_;
+    int document_id_;
+    bool closed_ = false;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <nlohmann/json.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <models/document.hpp>
+#include <utils/rope.hpp>
+
+namespace net = boost::asio;
+
+// Positional operational transform over TextOperation batches. A batch is
+// applied left to right, each operation seeing the text left by the previous
+// one.
+class OperationalTransform
+{
+public:
+    using Operations = std::vector<TextOperation>;
+
+    // Rewrites two batches made against the same text so that
+    // apply(apply(text, b), a') == apply(apply(text, a), b'). On equal
+    // insert positions b's text ends up first.
+    static std::pair<Operations, Operations> transform(const Operations &a, const Operations &b);
+
+    // {"type": "insert", "position", "text"} / {"type": "delete", "position", "length"}
+    static Operations fromJson(const nlohmann::json &operations);
+    static nlohmann::json toJson(const Operations &operations);
+
+private:
+    static std::pair<Operations, Operations> transformPair(const TextOperation &a, const TextOperation &b);
+};
+
+// A connected editor; implemented by the WebSocket session. send() may be
+// called from any thread and must not block.
+class CollaborationClient
+{
+public:
+    virtual ~CollaborationClient() = default;
+    virtual void send(std::shared_ptr<const std::string> message) = 0;
+    virtual void close() = 0;
+};
+
+// Live editing state of one document. Every member runs on the room's strand,
+// so rooms never contend with each other. A client sends a batch tagged with
+// the last revision it has seen and waits for the ack before sending the
+// next one. The room transforms the batch against everything applied since
+// that revision, applies it, acks the sender and broadcasts it to everyone
+// else. Applied batches are written back through Document::applyOperations
+// on a timer. If the stored document changed underneath, the room transforms
+// its unsaved batches over that change and broadcasts the change like any
+// other batch; only when that is impossible does it drop them and send
+// everyone a fresh snapshot.
+class CollaborationRoom : public std::enable_shared_from_this<CollaborationRoom>
+{
+public:
+    CollaborationRoom(net::io_context &ioContext, int documentId);
+
+    void join(std::shared_ptr<CollaborationClient> client);
+    void leave(const std::shared_ptr<CollaborationClient> &client);
+    void submit(std::shared_ptr<CollaborationClient> client, uint64_t revision, OperationalTransform::Operations operations);
+
+private:
+    void load();
+    void loaded(std::shared_ptr<Document> document, bool failed);
+    std::shared_ptr<const std::string> snapshot() const;
+    void sendError(const std::shared_ptr<CollaborationClient> &client, const std::string &message);
+    void broadcast(const nlohmann::json &message, const CollaborationClient *except);
+    void apply(const std::shared_ptr<CollaborationClient> &client, uint64_t revision, OperationalTransform::Operations operations);
+    void record(const OperationalTransform::Operations &operations);
+    void schedule();
+    void onTimer();
+    void flush();
+    void flushed(const OperationalTransform::Operations &operations, int version, std::size_t saved, std::exception_ptr error);
+    void rebase();
+    void rebased(std::shared_ptr<Document> document, const std::optional<OperationalTransform::Operations> &remote);
+    void discardUnsaved();
+    void closeIfIdle();
+
+    net::strand<net::io_context::executor_type> m_strand;
+    net::steady_timer m_timer; // flush batching, or retrying a load
+    int m_documentId;
+
+    bool m_loading = false;
+    bool m_loaded = false;
+    std::vector<std::shared_ptr<CollaborationClient>> m_clients;
+
+    Rope m_content;
+    uint64_t m_revision = 0;
+    // Batches applied at revisions [m_historyStart, m_revision)
+    std::deque<OperationalTransform::Operations> m_history;
+    uint64_t m_historyStart = 0;
+
+    // Applied but not yet persisted, and the database version they apply to
+    OperationalTransform::Operations m_unsaved;
+    int m_persistedVersion = 0;
+    bool m_flushing = false;
+    bool m_timerArmed = false;
+};
+
+// Hands out one room per document and forgets rooms once their last client
+// has left and their edits are saved, so idle documents cost nothing. Only
+// opening and closing a room take the lock.
+class CollaborationManager
+{
+public:
+    static CollaborationManager &getInstance()
+    {
+        static CollaborationManager instance;
+        return instance;
+    }
+
+    void initialize(net::io_context &ioContext);
+
+    // Every open() is paired with a close() once the caller is done with the
+    // room. Throws if the manager has not been initialized.
+    std::shared_ptr<CollaborationRoom> open(int documentId);
+    void close(int documentId);
+
+    // Called by an idle room; forgets it unless someone opened it meanwhile
+    void release(int documentId, const CollaborationRoom *room);
+
+    std::size_t activeRooms();
+
+private:
+    CollaborationManager() = default;
+
+    CollaborationManager(const CollaborationManager &) = delete;
+    CollaborationManager &operator=(const CollaborationManager &) = delete;
+
+    struct Entry
+    {
+        std::shared_ptr<CollaborationRoom> room;
+        std::size_t holders = 0;
+    };
+
+    net::io_context *m_ioContext = nullptr;
+    std::unordered_map<int, Entry> m_rooms;
+    std::mutex m_mutex;
+};
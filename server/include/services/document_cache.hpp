@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <models/document.hpp>
+
+struct CacheMetrics
+{
+    std::size_t byteBudget = 0;
+    std::size_t bytes = 0;
+    std::size_t entries = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+// Lock-striped LRU cache of documents keyed by id, bounded by a byte budget
+// split evenly across the shards. Document::findById fills it and
+// Document::save/remove write through, so the database stays the source of
+// truth. Disabled (every lookup misses) until initialize() is called.
+class DocumentCache
+{
+public:
+    static DocumentCache &getInstance()
+    {
+        static DocumentCache instance;
+        return instance;
+    }
+
+    void initialize(std::size_t byteBudget, std::size_t shardCount);
+
+    // Returns a private copy of the cached document, or nullptr on a miss.
+    // Copies share the content rope, so this does not copy the text.
+    std::shared_ptr<Document> get(int id);
+
+    // Readers take a generation before loading from the database and pass it
+    // to fill(); a write to the same shard in between makes fill() a no-op so
+    // a slow reader cannot reinsert a stale row.
+    uint64_t generation(int id);
+    void fill(const Document &document, uint64_t generation);
+
+    // Write-through from committed changes
+    void put(const Document &document);
+    // Write-through of a document brought forward from the copy get()
+    // returned at generation: stored if the shard is still at generation and
+    // dropped otherwise, since a concurrent writer may hold a newer version.
+    // Either way the generation moves on, so a reader that loaded the old row
+    // before the write can no longer fill() it back in.
+    void replace(const Document &document, uint64_t generation);
+    void invalidate(int id);
+    void clear();
+
+    CacheMetrics getMetrics();
+
+private:
+    DocumentCache() = default;
+
+    DocumentCache(const DocumentCache &) = delete;
+    DocumentCache &operator=(const DocumentCache &) = delete;
+
+    struct Entry
+    {
+        int id;
+        std::shared_ptr<const Document> document;
+        std::size_t bytes;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> entries; // most recently used first
+        std::unordered_map<int, std::list<Entry>::iterator> index;
+        std::size_t bytes = 0;
+        uint64_t generation = 0;
+    };
+
+    Shard *shardFor(int id);
+    void insertLocked(Shard &shard, std::shared_ptr<const Document> document);
+    void eraseLocked(Shard &shard, int id);
+
+    static std::shared_ptr<const Document> snapshot(const Document &document);
+    static std::size_t footprint(const Document &document);
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::size_t m_shardBudget = 0;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_evictions{0};
+};
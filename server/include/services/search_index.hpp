@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <models/document.hpp>
+
+// In-process BM25 index over document titles and content. It is built from
+// the documents table at startup (or restored from a snapshot and reconciled
+// with it), kept current by Document::save/remove and queried without a
+// database round-trip. Every call is a no-op until initialize() succeeds.
+class SearchIndex
+{
+public:
+    static SearchIndex &getInstance()
+    {
+        static SearchIndex instance;
+        return instance;
+    }
+
+    // Restores the snapshot at snapshotPath when it is usable, otherwise
+    // indexes every document. Throws if the documents cannot be read.
+    void initialize(const std::string &snapshotPath);
+    bool isReady() const;
+
+    // Adds or replaces a document; called after its transaction commits
+    void index(const Document &document);
+    void remove(int id);
+    // Moves a document to authorId; version and updatedAt are the values
+    // the reassigning UPDATE left on the row
+    void assignAuthor(int id, int authorId, int version, time_t updatedAt);
+    // Reloads one document from the database after another instance changed
+    // it. Blocks on the database, so it belongs on the DatabaseExecutor.
+    void refresh(int id);
+    // Compares every indexed version with the database, for when change
+    // notifications may have been missed. Blocks on the database but holds
+    // the index lock only while applying each batch.
+    void reconcile();
+
+    // Same contract as Document::search. Terms are OR-ed and ranked with BM25.
+    DocumentPage search(const std::string &query, int author_id, bool includePrivate,
+                              int limit = 20, const std::string &cursor = "") const;
+
+    // Compacts the index and writes it to the snapshot path
+    bool saveSnapshot();
+
+private:
+    SearchIndex() = default;
+
+    SearchIndex(const SearchIndex &) = delete;
+    SearchIndex &operator=(const SearchIndex &) = delete;
+
+    struct DocumentEntry
+    {
+        int id = -1;
+        uint32_t length = 0;
+        bool live = false;
+        std::string title;
+        int authorId = -1;
+        bool isPublic = false;
+        int version = 1;
+        time_t createdAt = 0;
+        time_t updatedAt = 0;
+        std::vector<uint32_t> terms; // distinct term ids, for removal
+    };
+
+    // Postings are (ordinal delta, term frequency) pairs encoded as varints.
+    // Ordinals only ever grow, so new documents are appended in place and
+    // replaced documents are tombstoned until the next compaction.
+    struct PostingList
+    {
+        std::vector<uint8_t> bytes;
+        uint32_t lastOrdinal = 0;
+        uint32_t documentFrequency = 0; // live documents only
+    };
+
+    void indexLocked(const Document &document);
+    void indexIfNewerLocked(const Document &document);
+    void removeLocked(int id);
+    void compactLocked();
+    void buildFromDatabase();
+    bool loadSnapshot();
+    void reconcileWithDatabase();
+    static Document fromIndexRow(const pqxx::row &row);
+
+    static std::vector<std::string> tokenize(std::string_view text);
+
+    std::string m_snapshotPath;
+    bool m_ready = false;
+
+    std::unordered_map<std::string, uint32_t> m_termIds;
+    std::vector<std::string> m_terms;
+    std::vector<PostingList> m_postings;
+    std::vector<DocumentEntry> m_documents;    // indexed by ordinal
+    std::unordered_map<int, uint32_t> m_ordinals; // document id -> live ordinal
+    uint64_t m_totalLength = 0;
+    std::size_t m_tombstones = 0;
+
+    mutable std::shared_mutex m_mutex;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Writes JSON text straight into a string, for responses too large to build
+// as an nlohmann::json tree first. The caller keeps the structure valid:
+// every object member starts with key(). Output matches json::dump() for the
+// same values when object members are written in key order (nlohmann sorts
+// them), so the two can be mixed freely.
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::string &out) : m_out(out) {}
+
+    JsonWriter &beginObject();
+    JsonWriter &endObject();
+    JsonWriter &beginArray();
+    JsonWriter &endArray();
+    JsonWriter &key(std::string_view name);
+
+    JsonWriter &value(std::string_view text);
+    JsonWriter &value(const char *text) { return value(std::string_view(text)); }
+    JsonWriter &value(bool flag);
+    JsonWriter &null();
+
+    template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    JsonWriter &value(T number)
+    {
+        separate();
+        char buffer[24];
+        auto end = std::to_chars(buffer, buffer + sizeof(buffer), number).ptr;
+        m_out.append(buffer, end);
+        return *this;
+    }
+
+    // A string value written in pieces, e.g. from a Rope. Escaping works per
+    // byte, so pieces may split the text anywhere, even inside a character.
+    JsonWriter &beginString();
+    JsonWriter &appendString(std::string_view piece);
+    JsonWriter &endString();
+
+    // Appends text as the body of a JSON string literal, without quotes
+    static void escape(std::string &out, std::string_view text);
+
+private:
+    // Emits the comma before every element but the first of a container
+    void separate();
+
+    std::string &m_out;
+    std::vector<bool> m_empty; // per open container: nothing written yet
+    bool m_afterKey = false;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Immutable balanced tree of UTF-8 text chunks. Positions count code points
+// (like Postgres' char_length/overlay). insert and erase are O(log n) and
+// share every untouched chunk with the previous value, so copying a rope is
+// a pointer copy and serves as a snapshot. str() flattens on demand.
+class Rope
+{
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+public:
+    Rope() = default;
+    explicit Rope(std::string_view text);
+
+    std::size_t length() const;   // code points
+    std::size_t byteSize() const; // UTF-8 bytes
+    bool empty() const { return length() == 0; }
+
+    // Throw std::out_of_range when the range is outside the text
+    void insert(std::size_t position, std::string_view text);
+    void erase(std::size_t position, std::size_t count);
+
+    std::string str() const;
+
+    // Visits the text leaf by leaf, in order, without flattening it. Holds
+    // its own reference to the tree, so it stays valid however the rope it
+    // was made from changes afterwards.
+    class ChunkReader
+    {
+    public:
+        explicit ChunkReader(const Rope &rope);
+        // Sets chunk to the next piece of text; false at the end
+        bool next(std::string_view &chunk);
+
+    private:
+        NodePtr m_root;
+        std::vector<const Node *> m_stack;
+        const Node *m_node;
+    };
+
+    static std::size_t utf8Length(std::string_view text);
+
+private:
+
+    static NodePtr build(std::string_view text);
+    static NodePtr leaf(std::string text);
+    static NodePtr branch(NodePtr left, NodePtr right);
+    static NodePtr balance(NodePtr left, NodePtr right);
+    static NodePtr join(const NodePtr &left, const NodePtr &right);
+    static std::pair<NodePtr, NodePtr> split(const NodePtr &node, std::size_t position);
+    static int height(const NodePtr &node);
+
+    NodePtr m_root;
+};
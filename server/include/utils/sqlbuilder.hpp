@@ -1,5 +1,7 @@
 #pragma once
+#include <cstddef>
 #include <string>
+#include <variant>
 #include <vector>
 
 struct where_condition
@@ -10,23 +12,40 @@ struct where_condition
     std::vector<std::string> values;
 };
 
+// A bound value for a parameterized query
+using sql_param = std::variant<std::nullptr_t, bool, long long, double, std::string>;
+
+// SQL text with $1..$n placeholders and the values bound to them, in order
+struct parameterized_query
+{
+    std::string sql;
+    std::vector<sql_param> params;
+};
+
 class SQLBuilder
 {
 private:
     std::string selectClause;
-    std::string insertClause;
+    std::string insertTable;
+    std::vector<std::string> insertColumns;
+    std::vector<std::string> insertValues;
     std::string deleteClause;
     std::string updateClause;
-    std::string setClause;
+    std::vector<std::pair<std::string, std::string>> setUpdates;
     std::string fromClause;
-    std::string whereClause;
     std::string orderByClause;
-    std::string limitClause;
+    std::string limitValue;
     std::string customQuery;
     std::string returningClause;
     bool isCustomQuery;
     std::vector<std::vector<where_condition>> whereConditions; // Change from string to vector of conditions
 
+    // Renders the query; values are bound into params when it is given and
+    // inlined as quoted literals otherwise.
+    std::string render(std::vector<sql_param> *params) const;
+    std::string renderValue(const std::string &value, std::vector<sql_param> *params, bool quote = true) const;
+    std::string renderWhere(std::vector<sql_param> *params) const;
+
 public:
     SQLBuilder() : isCustomQuery(false)
     {
@@ -46,4 +65,7 @@ public:
     SQLBuilder &returning(const std::vector<std::string> &column);
 
     std::string build() const;
+    // Same query with $1..$n placeholders, ready for exec_params or a
+    // prepared statement.
+    parameterized_query buildParameterized() const;
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+-- Full-text search over title and content. The generated column keeps the
+-- tsvector in sync on every write and the GIN index serves @@ matches, so
+-- searches no longer scan the whole table with LIKE '%query%'.
+--
+-- A tsvector must stay under 1MB, so only the first 256KB of content is
+-- indexed. The cap is in bytes because multibyte text takes up to four bytes
+-- per character. Each distinct lexeme costs its own bytes plus at most 9
+-- bytes of entry, alignment and position data, while taking at least one
+-- more byte than its length in the input. Words of three or more bytes
+-- therefore grow by at most 3x, and the few shorter lexemes that exist add
+-- well under 100KB, so 256KB of input leaves a wide margin.
+
+-- Longest prefix of content that is at most max_bytes long, cut at a
+-- character boundary
+CREATE OR REPLACE FUNCTION document_search_text(content text, max_bytes integer)
+RETURNS text AS $$
+DECLARE
+    bytes bytea;
+    cut integer := max_bytes;
+BEGIN
+    IF octet_length(content) <= max_bytes THEN
+        RETURN content;
+    END IF;
+
+    -- left() counts characters, so this keeps at least max_bytes + 1 bytes
+    bytes := convert_to(left(content, max_bytes + 1), 'UTF8');
+
+    -- Step back while the first dropped byte continues a character
+    WHILE cut > 0 AND (get_byte(bytes, cut) & 192) = 128 LOOP
+        cut := cut - 1;
+    END LOOP;
+
+    RETURN convert_from(substring(bytes FROM 1 FOR cut), 'UTF8');
+END;
+$$ LANGUAGE plpgsql IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION document_search_vector(title text, content text)
+RETURNS tsvector AS $$
+    SELECT setweight(to_tsvector('english', coalesce(title, '')), 'A') ||
+           setweight(to_tsvector('english', document_search_text(coalesce(content, ''), 262144)), 'B')
+$$ LANGUAGE sql IMMUTABLE PARALLEL SAFE;
+
+ALTER TABLE documents ADD COLUMN IF NOT EXISTS search_vector tsvector
+    GENERATED ALWAYS AS (document_search_vector(title, content)) STORED;
+
+CREATE INDEX IF NOT EXISTS idx_documents_search_vector ON documents USING GIN (search_vector);
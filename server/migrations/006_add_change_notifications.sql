@@ -0,0 +1,29 @@
+-- Publish the id of every changed row so that other backend instances can
+-- drop their cached copies. The channel name is the trigger argument.
+-- Payloads are "<id>:<instance id>": an instance skips the notifications
+-- its own writes trigger, having already brought its cache and search index
+-- up to date. Pool connections set app.instance_id when they connect;
+-- writes from anywhere else carry an empty tag and reach every instance.
+CREATE OR REPLACE FUNCTION notify_row_change()
+RETURNS TRIGGER AS $$
+DECLARE
+    writer text := coalesce(current_setting('app.instance_id', true), '');
+BEGIN
+    IF TG_OP = 'DELETE' THEN
+        PERFORM pg_notify(TG_ARGV[0], OLD.id::text || ':' || writer);
+    ELSE
+        PERFORM pg_notify(TG_ARGV[0], NEW.id::text || ':' || writer);
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE OR REPLACE TRIGGER documents_notify_change
+    AFTER INSERT OR UPDATE OR DELETE ON documents
+    FOR EACH ROW
+    EXECUTE FUNCTION notify_row_change('documents_changed');
+
+CREATE OR REPLACE TRIGGER authors_notify_change
+    AFTER INSERT OR UPDATE OR DELETE ON authors
+    FOR EACH ROW
+    EXECUTE FUNCTION notify_row_change('authors_changed');
@@ -0,0 +1,3 @@
+-- Revision counter used for optimistic concurrency on edits. The version
+-- trigger from 002 already bumps it whenever content changes.
+ALTER TABLE documents ADD COLUMN IF NOT EXISTS version INTEGER NOT NULL DEFAULT 1;
@@ -0,0 +1,17 @@
+-- Content history. Every saved version is either a full snapshot or a
+-- binary delta (encoded TextOperations) from the version before it; a
+-- snapshot is written every few versions so reconstruction stays short.
+CREATE TABLE IF NOT EXISTS document_versions (
+    document_id INTEGER NOT NULL REFERENCES documents(id) ON DELETE CASCADE,
+    version INTEGER NOT NULL,
+    snapshot TEXT,
+    delta BYTEA,
+    created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    PRIMARY KEY (document_id, version),
+    CHECK ((snapshot IS NULL) <> (delta IS NULL))
+);
+
+-- History starts at the current version of existing documents
+INSERT INTO document_versions (document_id, version, snapshot, created_at)
+SELECT id, version, coalesce(content, ''), updated_at FROM documents
+ON CONFLICT (document_id, version) DO NOTHING;
@@ -0,0 +1,45 @@
+-- The version doubles as the document's ETag, so it has to move whenever
+-- anything a client sees changes, not only the content. updated_at follows
+-- it so Last-Modified stays truthful.
+CREATE OR REPLACE FUNCTION document_version_increment()
+RETURNS TRIGGER AS $$
+BEGIN
+    IF (NEW.title, NEW.content, NEW.is_public, NEW.author_id) IS DISTINCT FROM
+       (OLD.title, OLD.content, OLD.is_public, OLD.author_id) THEN
+        NEW.version = OLD.version + 1;
+        NEW.updated_at = CURRENT_TIMESTAMP;
+    END IF;
+    RETURN NEW;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Versions that leave the content alone (renames, visibility, ownership)
+-- are recorded here so the history chain has no gaps: a snapshot on
+-- snapshot-boundary versions, an empty delta otherwise. Content changes are
+-- recorded by the application, which knows the delta. The interval comes
+-- from the app.document_snapshot_interval setting that pool connections set
+-- when they connect; writes from elsewhere always record an empty delta.
+CREATE OR REPLACE FUNCTION document_record_unchanged_content()
+RETURNS TRIGGER AS $$
+DECLARE
+    snapshot_interval integer := nullif(current_setting('app.document_snapshot_interval', true), '')::integer;
+BEGIN
+    IF NEW.version <> OLD.version AND NEW.content IS NOT DISTINCT FROM OLD.content THEN
+        IF snapshot_interval > 0 AND (NEW.version - 1) % snapshot_interval = 0 THEN
+            INSERT INTO document_versions (document_id, version, snapshot)
+            VALUES (NEW.id, NEW.version, coalesce(NEW.content, ''))
+            ON CONFLICT (document_id, version) DO NOTHING;
+        ELSE
+            INSERT INTO document_versions (document_id, version, delta)
+            VALUES (NEW.id, NEW.version, '\x00'::bytea)
+            ON CONFLICT (document_id, version) DO NOTHING;
+        END IF;
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE OR REPLACE TRIGGER document_unchanged_content_trigger
+    AFTER UPDATE ON documents
+    FOR EACH ROW
+    EXECUTE FUNCTION document_record_unchanged_content();
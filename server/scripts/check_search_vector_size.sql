@@ -0,0 +1,30 @@
+-- Checks that the search vector cap holds on a worst-case document. Run it
+-- by hand against a migrated database; it changes nothing.
+--
+--   psql "$DATABASE_URL" -f scripts/check_search_vector_size.sql
+--
+-- A large multibyte document shaped to maximise the vector: distinct short
+-- Cyrillic, CJK and ASCII words, several megabytes in all, with the cut
+-- landing inside a character. It has to index without error.
+DO $$
+DECLARE
+    document text;
+    vector tsvector;
+BEGIN
+    SELECT string_agg(
+               CASE i % 3
+                   WHEN 0 THEN chr(1072 + i % 32) || chr(1072 + (i / 32) % 32) || chr(1072 + (i / 1024) % 32)
+                   WHEN 1 THEN chr(19968 + i % 20902)
+                   ELSE chr(97 + i % 26) || chr(97 + (i / 26) % 26) || chr(97 + (i / 676) % 26)
+               END,
+               ' ')
+      INTO document
+      FROM generate_series(0, 999999) AS i;
+
+    vector := document_search_vector('Search vector size check', document);
+
+    IF octet_length(document) <= 262144 OR length(vector) = 0 THEN
+        RAISE EXCEPTION 'search vector size check did not exercise the byte cap';
+    END IF;
+END;
+$$;
@@ -18,15 +18,12 @@ std::string AuthController::hashPassword(const std::string &password)
     return std::to_string(std::hash<std::string>{}(password));
 }
 
-json AuthController::registerUser(const json &userData)
+json AuthController::registerUser(const std::string &name, const std::string &email, const std::string &password)
 {
     try
     {
         Logger::info({"Starting user registration"});
 
-        std::string name = userData["name"];
-        std::string email = userData["email"];
-        std::string password = userData["password"];
         AuthorController authorController;
         json authorResponse = authorController.createAuthor(name, email, password);
 
@@ -45,15 +42,12 @@ json AuthController::registerUser(const json &userData)
     }
 }
 
-json AuthController::loginUser(const json &userData)
+json AuthController::loginUser(const std::string &email, const std::string &password)
 {
     try
     {
         Logger::info({"Starting user login"});
 
-        std::string email = userData["email"];
-        std::string password = userData["password"];
-
         AuthorController authorController;
         json authorResponse = authorController.getAuthor(email, true);
         if (authorResponse.find("error") != authorResponse.end())
@@ -103,4 +97,19 @@ json AuthController::me(const std::string &token)
         Logger::error({"Error in me: " + std::string(e.what())});
         return formatErrorResponse(e.what());
     }
-}
\ No newline at end of file
+}
+std::optional<std::string> AuthController::meFingerprint(const std::string &token)
+{
+    try
+    {
+        json payload = jwtManager.verifySignatureAndDecode(token, AppConfig::getInstance().getSecretKey());
+        int userId = payload["id"];
+        AuthorController authorController;
+        return authorController.getAuthorFingerprint(userId);
+    }
+    catch (const std::exception &e)
+    {
+        Logger::debug({"Cannot fingerprint 'me' response: " + std::string(e.what())});
+        return std::nullopt;
+    }
+}
@@ -68,6 +68,11 @@ json AuthorController::getAuthor(const std::string &email, bool send_password)
     }
 }
 
+std::optional<std::string> AuthorController::getAuthorFingerprint(int id)
+{
+    return Author::profileFingerprint(id);
+}
+
 json AuthorController::updateAuthor(int id, const json &updates)
 {
     auto author = Author::findById(id);
@@ -132,12 +137,15 @@ json AuthorController::formatAuthorResponse(const Author &author, bool send_pass
     response["name"] = author.getName();
     response["email"] = author.getEmail();
     
-    // Convert documents to JSON array
+    // First page of document metadata; the rest is paged through
+    // /authors/{id}/documents and content is fetched per document
     json documents_json = json::array();
     for (const auto& doc : author.getDocuments()) {
-        documents_json.push_back(DocumentController::documentToJson(*doc));
+        documents_json.push_back(DocumentController::documentMetadataToJson(*doc));
     }
     response["documents"] = documents_json;
+    const auto &cursor = author.getDocumentsCursor();
+    response["documents_next_cursor"] = cursor.empty() ? json(nullptr) : json(cursor);
 
     if (send_password)
     {
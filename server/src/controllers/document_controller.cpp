@@ -1,6 +1,10 @@
 #include <controllers/document_controller.hpp>
 #include <models/document.hpp>
+#include <models/document_history.hpp>
+#include <services/search_index.hpp>
+#include <services/collaboration.hpp>
 #include <utils/logger.hpp>
+#include <config/app_config.hpp>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
@@ -14,7 +18,7 @@ DocumentController::DocumentController()
     Logger::info({"DocumentController initialized"});
 }
 
-nlohmann::json DocumentController::createDocument(const std::string &title, const std::string &content, const std::string &owner)
+nlohmann::json DocumentController::createDocument(const std::string &title, std::string_view content, const std::string &owner)
 {
     try
     {
@@ -52,105 +56,225 @@ nlohmann::json DocumentController::getDocument(int id)
     }
 }
 
-nlohmann::json DocumentController::updateDocument(int id, const nlohmann::json &updates)
+void DocumentController::getDocumentAsync(int id, std::function<void(std::exception_ptr, std::shared_ptr<Document>)> callback)
+{
+    Logger::info({"Getting document with ID: " + std::to_string(id)});
+    Document::findByIdAsync(id, std::move(callback));
+}
+
+void DocumentController::getDocumentValidatorAsync(int id, std::function<void(std::exception_ptr, std::optional<DocumentValidator>)> callback)
+{
+    Document::findValidatorAsync(id, std::move(callback));
+}
+
+nlohmann::json DocumentController::updateDocument(int id, const DocumentChanges &changes, std::optional<int> expectedVersion)
 {
     try
     {
-        auto doc = Document::findById(id);
-        if (!doc)
-        {
-            return formatErrorResponse("Document not found");
-        }
+        auto doc = Document::update(id, changes, expectedVersion);
+        Logger::info({"Document updated: " + doc.getTitle()});
+        return documentMetadataToJson(doc);
+    }
+    catch (const VersionConflict &e)
+    {
+        Logger::warn({"Rejected stale update of document " + std::to_string(id)});
+        json response = formatErrorResponse(e.what());
+        response["current_version"] = e.currentVersion;
+        return response;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to update document: " + std::string(e.what())});
+        return formatErrorResponse(e.what());
+    }
+}
 
-        if (updates.contains("title"))
+nlohmann::json DocumentController::patchDocument(int id, const nlohmann::json &patch)
+{
+    try
+    {
+        if (!patch.contains("base_version") || !patch.contains("operations") || !patch["operations"].is_array())
         {
-            doc->setTitle(updates["title"]);
+            return formatErrorResponse("Expected base_version and an operations array");
         }
-        if (updates.contains("content"))
+
+        auto operations = OperationalTransform::fromJson(patch["operations"]);
+        auto doc = Document::applyOperations(id, patch["base_version"].get<int>(), operations);
+        return documentMetadataToJson(doc);
+    }
+    catch (const VersionConflict &e)
+    {
+        Logger::warn({"Rejected stale edit of document " + std::to_string(id)});
+        json response = formatErrorResponse(e.what());
+        response["current_version"] = e.currentVersion;
+        return response;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to patch document: " + std::string(e.what())});
+        return formatErrorResponse(e.what());
+    }
+}
+
+nlohmann::json DocumentController::deleteDocument(int id, std::optional<int> expectedVersion)
+{
+    try
+    {
+        if (Document::removeById(id, expectedVersion))
         {
-            doc->setContent(updates["content"]);
+            Logger::info({"Document deleted: " + std::to_string(id)});
+            return json{{"success", true}, {"message", "Document deleted successfully"}};
         }
-        if (updates.contains("is_public"))
+        return formatErrorResponse("Document not found");
+    }
+    catch (const VersionConflict &e)
+    {
+        Logger::warn({"Rejected stale delete of document " + std::to_string(id)});
+        json response = formatErrorResponse(e.what());
+        response["current_version"] = e.currentVersion;
+        return response;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to delete document: " + std::string(e.what())});
+        return formatErrorResponse(e.what());
+    }
+}
+
+DocumentPage DocumentController::findSearchPage(const std::string &query, int author_id, int limit, const std::string &cursor)
+{
+    Logger::info({"Searching documents with query: " + query});
+    auto &index = SearchIndex::getInstance();
+    return index.isReady()
+               ? index.search(query, author_id, false, limit, cursor)
+               : Document::search(query, author_id, false, limit, cursor);
+}
+
+nlohmann::json DocumentController::searchDocuments(const std::string &query, int author_id, int limit, const std::string &cursor)
+{
+    try
+    {
+        auto page = findSearchPage(query, author_id, limit, cursor);
+        const auto &documents = page.documents;
+        if (documents.empty() && cursor.empty())
         {
-            doc->setPublic(updates["is_public"]);
+            return formatErrorResponse("No documents found");
         }
-
-        if (doc->save())
+        json response = json::array();
+        for (const auto &doc : documents)
         {
-            Logger::info({"Document updated: " + doc->getTitle()});
-            return formatDocumentResponse(*doc);
+            response.push_back(documentMetadataToJson(doc));
         }
-        return formatErrorResponse("Failed to update document");
+        json result{{"documents", response}};
+        result["next_cursor"] = page.nextCursor.empty() ? json(nullptr) : json(page.nextCursor);
+        return result;
     }
     catch (const std::exception &e)
     {
-        Logger::error({"Failed to update document: " + std::string(e.what())});
+        Logger::error({"Failed to search documents: " + std::string(e.what())});
         return formatErrorResponse(e.what());
     }
 }
 
-nlohmann::json DocumentController::deleteDocument(int id)
+std::string DocumentController::searchDocumentsJson(const std::string &query, int author_id, int limit, const std::string &cursor)
 {
     try
     {
-        auto doc = Document::findById(id);
-        if (!doc)
+        auto page = findSearchPage(query, author_id, limit, cursor);
+        if (page.documents.empty() && cursor.empty())
         {
-            return formatErrorResponse("Document not found");
+            return formatErrorResponse("No documents found").dump();
         }
 
-        if (doc->remove())
+        std::string body;
+        JsonWriter writer(body);
+        writer.beginObject().key("documents").beginArray();
+        for (const auto &doc : page.documents)
         {
-            Logger::info({"Document deleted: " + doc->getTitle()});
-            return json{{"success", true}, {"message", "Document deleted successfully"}};
+            writeDocumentMetadata(writer, doc);
+        }
+        writer.endArray().key("next_cursor");
+        if (page.nextCursor.empty())
+        {
+            writer.null();
+        }
+        else
+        {
+            writer.value(page.nextCursor);
         }
-        return formatErrorResponse("Failed to delete document");
+        writer.endObject();
+        return body;
     }
     catch (const std::exception &e)
     {
-        Logger::error({"Failed to delete document: " + std::string(e.what())});
-        return formatErrorResponse(e.what());
+        Logger::error({"Failed to search documents: " + std::string(e.what())});
+        return formatErrorResponse(e.what()).dump();
     }
 }
 
-// std::vector<Document> DocumentController::getAllDocumentsOfAuthor(const std::string &owner)
-// {
-//     Logger::info({"Getting all documents of author: " + owner});
-//     return Document::search("", owner, true);
-// }
-
-// std::vector<Document> DocumentController::getAllPublicDocuments()
-// {
-//     Logger::info({"Getting all public documents"});
-//     return Document::search("", "", false);
-// }
+nlohmann::json DocumentController::getAuthorDocuments(int author_id, bool includePrivate, int limit, const std::string &cursor)
+{
+    try
+    {
+        auto page = Document::findByAuthor(author_id, includePrivate, limit, cursor);
+        json documents = json::array();
+        for (const auto &doc : page.documents)
+        {
+            documents.push_back(documentMetadataToJson(doc));
+        }
+        json result{{"documents", documents}};
+        result["next_cursor"] = page.nextCursor.empty() ? json(nullptr) : json(page.nextCursor);
+        return result;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to list documents of author: " + std::string(e.what())});
+        return formatErrorResponse(e.what());
+    }
+}
 
-nlohmann::json DocumentController::searchDocuments(const std::string &query, int author_id)
+nlohmann::json DocumentController::getDocumentVersions(int id, int limit, int before)
 {
     try
     {
-        Logger::info({"Searching documents with query: " + query});
-        auto documents = Document::search(query, author_id, false);
-        if (documents.empty())
+        auto page = DocumentHistory::list(id, limit, before);
+        json versions = json::array();
+        for (const auto &version : page.versions)
         {
-            return formatErrorResponse("No documents found");
+            versions.push_back({{"version", version.version},
+                                {"created_at", version.created_at},
+                                {"snapshot", version.isSnapshot},
+                                {"stored_bytes", version.storedBytes}});
         }
-        json response = json::array();
-        for (const auto &doc : documents)
+        json result{{"id", id}, {"versions", versions}};
+        result["next_before"] = page.nextBefore ? json(page.nextBefore) : json(nullptr);
+        return result;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to list document versions: " + std::string(e.what())});
+        return formatErrorResponse(e.what());
+    }
+}
+
+nlohmann::json DocumentController::getDocumentVersion(int id, int version)
+{
+    try
+    {
+        auto found = DocumentHistory::find(id, version);
+        if (!found)
         {
-            response.push_back(json{
-                {"id", doc.getId()},
-                {"title", doc.getTitle()},
-                {"author_id", doc.getAuthorId()},
-                {"created_at", doc.getCreatedAt()},
-                {"updated_at", doc.getUpdatedAt()},
-                {"is_public", doc.isPublic()}});
+            return formatErrorResponse("Version not found");
         }
-        return json{{"documents", response}};
+        return json{
+            {"id", id},
+            {"version", found->version},
+            {"content", found->content},
+            {"created_at", found->created_at}};
     }
     catch (const std::exception &e)
     {
-        Logger::error({"Failed to search documents: " + std::string(e.what())});
+        Logger::error({"Failed to get document version: " + std::string(e.what())});
         return formatErrorResponse(e.what());
     }
 }
@@ -170,10 +294,118 @@ nlohmann::json DocumentController::documentToJson(const Document& doc)
         {"author_id", doc.getAuthorId()},
         {"created_at", doc.getCreatedAt()},
         {"updated_at", doc.getUpdatedAt()},
-        {"is_public", doc.isPublic()}
+        {"is_public", doc.isPublic()},
+        {"version", doc.getVersion()}
+    };
+}
+
+nlohmann::json DocumentController::documentMetadataToJson(const Document& doc)
+{
+    return json{
+        {"id", doc.getId()},
+        {"title", doc.getTitle()},
+        {"author_id", doc.getAuthorId()},
+        {"created_at", doc.getCreatedAt()},
+        {"updated_at", doc.getUpdatedAt()},
+        {"is_public", doc.isPublic()},
+        {"version", doc.getVersion()}
     };
 }
 
+// Members are written in key order so the output matches documentToJson
+void DocumentController::writeDocument(JsonWriter &writer, const Document &doc)
+{
+    writer.beginObject().key("author_id").value(doc.getAuthorId()).key("content").beginString();
+    Rope::ChunkReader reader(doc.getContentRope());
+    std::string_view chunk;
+    while (reader.next(chunk))
+    {
+        writer.appendString(chunk);
+    }
+    writer.endString();
+    writeDocumentTail(writer, doc);
+}
+
+void DocumentController::writeDocumentMetadata(JsonWriter &writer, const Document &doc)
+{
+    writer.beginObject().key("author_id").value(doc.getAuthorId());
+    writeDocumentTail(writer, doc);
+}
+
+void DocumentController::writeDocumentTail(JsonWriter &writer, const Document &doc)
+{
+    writer.key("created_at").value(doc.getCreatedAt())
+        .key("id").value(doc.getId())
+        .key("is_public").value(doc.isPublic())
+        .key("title").value(doc.getTitle())
+        .key("updated_at").value(doc.getUpdatedAt())
+        .key("version").value(doc.getVersion())
+        .endObject();
+}
+
+namespace
+{
+    // writeDocument cut into pieces: the members up to content, then the
+    // content escaped straight from the rope, then the remaining members.
+    // Holds the document, so the rope stays alive whatever happens to the
+    // cached copy meanwhile.
+    class DocumentJsonStream : public ResponseStream
+    {
+    public:
+        DocumentJsonStream(std::shared_ptr<const Document> doc, std::size_t chunkSize)
+            : m_document(std::move(doc)), m_reader(m_document->getContentRope()),
+              m_writer(m_buffer), m_chunkSize(chunkSize) {}
+
+        bool next(std::string &out) override
+        {
+            if (m_finished)
+            {
+                return false;
+            }
+
+            m_buffer.clear();
+            if (!m_started)
+            {
+                m_writer.beginObject().key("author_id").value(m_document->getAuthorId()).key("content").beginString();
+                m_started = true;
+            }
+
+            while (m_buffer.size() < m_chunkSize)
+            {
+                if (m_pending.empty() && !m_reader.next(m_pending))
+                {
+                    m_writer.endString();
+                    DocumentController::writeDocumentTail(m_writer, *m_document);
+                    m_finished = true;
+                    break;
+                }
+                auto piece = m_pending.substr(0, m_chunkSize - m_buffer.size());
+                m_writer.appendString(piece);
+                m_pending.remove_prefix(piece.size());
+            }
+
+            // Swapping hands over the piece and keeps both buffers' capacity
+            out.swap(m_buffer);
+            return true;
+        }
+
+    private:
+        std::shared_ptr<const Document> m_document;
+        Rope::ChunkReader m_reader;
+        std::string_view m_pending;
+        std::string m_buffer;
+        JsonWriter m_writer;
+        std::size_t m_chunkSize;
+        bool m_started = false;
+        bool m_finished = false;
+    };
+}
+
+std::shared_ptr<ResponseStream> DocumentController::streamDocument(std::shared_ptr<const Document> doc)
+{
+    return std::make_shared<DocumentJsonStream>(std::move(doc), AppConfig::getInstance().getResponseChunkSize());
+}
+
 nlohmann::json DocumentController::formatErrorResponse(const std::string &message)
 {
     return json{
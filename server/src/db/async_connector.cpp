@@ -0,0 +1,138 @@
+#include "db/async_connector.hpp"
+#include <boost/asio/post.hpp>
+
+using tcp = net::ip::tcp;
+
+void AsyncConnector::connect(tcp::socket &socket, const std::string &connectionString,
+                             std::chrono::milliseconds timeout, AsyncConnectHandler handler)
+{
+    std::make_shared<AsyncConnector>(socket, std::move(handler))->start(connectionString, timeout);
+}
+
+AsyncConnector::AsyncConnector(tcp::socket &socket, AsyncConnectHandler handler)
+    : m_socket(socket), m_timer(socket.get_executor()), m_handler(std::move(handler))
+{
+}
+
+void AsyncConnector::start(const std::string &connectionString, std::chrono::milliseconds timeout)
+{
+    auto self = shared_from_this();
+
+    m_conn = PQconnectStart(connectionString.c_str());
+    if (!m_conn || PQstatus(m_conn) == CONNECTION_BAD)
+    {
+        // Report on the executor like every other outcome, never inline
+        std::string error = m_conn ? PQerrorMessage(m_conn) : "out of memory";
+        net::post(m_socket.get_executor(), [self, error]()
+                  { self->fail(error); });
+        return;
+    }
+
+    // libpq does not enforce connect_timeout for polled connections
+    m_timer.expires_after(timeout);
+    m_timer.async_wait([self](const boost::system::error_code &ec)
+                       {
+                           if (ec)
+                           {
+                               return;
+                           }
+                           self->m_timedOut = true;
+                           boost::system::error_code ignored;
+                           self->m_socket.cancel(ignored); });
+
+    net::post(m_socket.get_executor(), [self]()
+              { self->poll(PGRES_POLLING_WRITING); });
+}
+
+void AsyncConnector::poll(PostgresPollingStatusType status)
+{
+    if (status == PGRES_POLLING_OK)
+    {
+        succeed();
+        return;
+    }
+    if (status == PGRES_POLLING_FAILED)
+    {
+        fail(PQerrorMessage(m_conn));
+        return;
+    }
+
+    if (!watchSocket())
+    {
+        return;
+    }
+
+    auto self = shared_from_this();
+    m_socket.async_wait(status == PGRES_POLLING_READING ? tcp::socket::wait_read : tcp::socket::wait_write,
+                        [self](const boost::system::error_code &ec)
+                        {
+                            if (self->m_timedOut)
+                            {
+                                self->fail("Connection attempt timed out");
+                                return;
+                            }
+                            if (ec)
+                            {
+                                self->fail(ec.message());
+                                return;
+                            }
+                            self->poll(PQconnectPoll(self->m_conn));
+                        });
+}
+
+bool AsyncConnector::watchSocket()
+{
+    // libpq opens a new socket for every address it tries
+    int fd = PQsocket(m_conn);
+    if (m_socket.is_open() && m_socket.native_handle() == fd)
+    {
+        return true;
+    }
+
+    boost::system::error_code ec;
+    if (m_socket.is_open())
+    {
+        m_socket.release(ec);
+    }
+    m_socket.assign(tcp::v4(), fd, ec);
+    if (ec)
+    {
+        fail("Failed to watch connection socket: " + ec.message());
+        return false;
+    }
+    return true;
+}
+
+void AsyncConnector::succeed()
+{
+    m_timer.cancel();
+    if (!watchSocket())
+    {
+        return;
+    }
+    if (PQsetnonblocking(m_conn, 1) != 0)
+    {
+        fail("Failed to switch connection to non-blocking mode");
+        return;
+    }
+
+    PGconn *conn = m_conn;
+    m_conn = nullptr;
+    m_handler(conn, std::string());
+}
+
+void AsyncConnector::fail(const std::string &error)
+{
+    m_timer.cancel();
+    if (m_socket.is_open())
+    {
+        boost::system::error_code ignored;
+        m_socket.release(ignored);
+    }
+    if (m_conn)
+    {
+        PQfinish(m_conn);
+        m_conn = nullptr;
+    }
+    m_handler(nullptr, error);
+}
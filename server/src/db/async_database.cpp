@@ -0,0 +1,443 @@
+#include "db/async_database.hpp"
+#include "db/async_connector.hpp"
+#include "config/app_config.hpp"
+#include "utils/logger.hpp"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <stdexcept>
+
+using tcp = net::ip::tcp;
+
+AsyncQueryResult::AsyncQueryResult(PGresult *result)
+    : m_result(result, PQclear) {}
+
+int AsyncQueryResult::rows() const
+{
+    return m_result ? PQntuples(m_result.get()) : 0;
+}
+
+int AsyncQueryResult::affectedRows() const
+{
+    if (!m_result)
+    {
+        return 0;
+    }
+    const char *count = PQcmdTuples(m_result.get());
+    return *count ? std::stoi(count) : 0;
+}
+
+int AsyncQueryResult::columnIndex(const char *column) const
+{
+    int index = m_result ? PQfnumber(m_result.get(), column) : -1;
+    if (index < 0)
+    {
+        throw std::out_of_range(std::string("Unknown column: ") + column);
+    }
+    return index;
+}
+
+bool AsyncQueryResult::isNull(int row, const char *column) const
+{
+    return PQgetisnull(m_result.get(), row, columnIndex(column)) == 1;
+}
+
+std::string AsyncQueryResult::getString(int row, const char *column) const
+{
+    int index = columnIndex(column);
+    return std::string(PQgetvalue(m_result.get(), row, index), PQgetlength(m_result.get(), row, index));
+}
+
+int AsyncQueryResult::getInt(int row, const char *column) const
+{
+    return std::stoi(PQgetvalue(m_result.get(), row, columnIndex(column)));
+}
+
+bool AsyncQueryResult::getBool(int row, const char *column) const
+{
+    return PQgetvalue(m_result.get(), row, columnIndex(column))[0] == 't';
+}
+
+// One libpq connection in non-blocking mode. Its socket is wrapped in an asio
+// socket purely for readiness notifications; libpq keeps ownership of the fd.
+// The first connection is made up front; after it drops, the connection
+// reconnects in the background without ever blocking the strand.
+class AsyncDatabase::Connection : public std::enable_shared_from_this<Connection>
+{
+public:
+    Connection(AsyncDatabase &owner, const std::string &connectionString)
+        : m_owner(owner),
+          m_socket(*owner.m_strand),
+          m_reconnectTimer(*owner.m_strand),
+          m_connectionString(connectionString)
+    {
+        connect();
+    }
+
+    ~Connection() { close(); }
+
+    bool connected() const
+    {
+        return m_conn && !m_broken && PQstatus(m_conn) == CONNECTION_OK;
+    }
+
+    // onFinished learns whether the connection survived the query
+    void execute(PendingQuery query, std::function<void(bool)> onFinished)
+    {
+        m_query = std::move(query);
+        m_onFinished = std::move(onFinished);
+        m_error.clear();
+        m_result = AsyncQueryResult();
+
+        std::vector<const char *> values;
+        values.reserve(m_query.params.size());
+        for (const auto &param : m_query.params)
+        {
+            values.push_back(param.c_str());
+        }
+
+        if (!PQsendQueryParams(m_conn, m_query.sql.c_str(), static_cast<int>(values.size()),
+                               nullptr, values.data(), nullptr, nullptr, 0))
+        {
+            finish(connectionError("Failed to send query"));
+            return;
+        }
+
+        flush();
+    }
+
+    void reconnect()
+    {
+        close();
+        if (m_stopped)
+        {
+            return;
+        }
+
+        auto self = shared_from_this();
+        m_reconnectTimer.expires_after(std::chrono::milliseconds(AppConfig::getInstance().getDatabaseReconnectDelayMs()));
+        m_reconnectTimer.async_wait(
+            [self](const boost::system::error_code &ec)
+            {
+                if (ec || self->m_stopped)
+                {
+                    return;
+                }
+                AsyncConnector::connect(
+                    self->m_socket, self->m_connectionString,
+                    std::chrono::milliseconds(AppConfig::getInstance().getDatabaseConnectTimeoutMs()),
+                    [self](PGconn *conn, const std::string &error)
+                    {
+                        if (self->m_stopped)
+                        {
+                            if (conn)
+                            {
+                                boost::system::error_code ignored;
+                                self->m_socket.release(ignored);
+                                PQfinish(conn);
+                            }
+                            return;
+                        }
+                        if (!conn)
+                        {
+                            Logger::warn({"Async database reconnect failed: " + error});
+                            self->reconnect();
+                            return;
+                        }
+                        self->m_conn = conn;
+                        Logger::info({"Async database connection re-established"});
+                        self->m_owner.restore(self);
+                    });
+            });
+    }
+
+    void stop()
+    {
+        m_stopped = true;
+        m_reconnectTimer.cancel();
+        close();
+    }
+
+private:
+    void connect()
+    {
+        m_conn = PQconnectdb(m_connectionString.c_str());
+        if (PQstatus(m_conn) != CONNECTION_OK)
+        {
+            std::string message = PQerrorMessage(m_conn);
+            PQfinish(m_conn);
+            m_conn = nullptr;
+            throw std::runtime_error("Failed to create async database connection: " + message);
+        }
+        if (PQsetnonblocking(m_conn, 1) != 0)
+        {
+            throw std::runtime_error("Failed to switch database connection to non-blocking mode");
+        }
+        m_socket.assign(tcp::v4(), PQsocket(m_conn));
+    }
+
+    void close()
+    {
+        if (m_socket.is_open())
+        {
+            boost::system::error_code ignored;
+            m_socket.release(ignored);
+        }
+        if (m_conn)
+        {
+            PQfinish(m_conn);
+            m_conn = nullptr;
+        }
+        m_broken = false;
+    }
+
+    void flush()
+    {
+        int status = PQflush(m_conn);
+        if (status < 0)
+        {
+            finish(connectionError("Failed to flush query"));
+            return;
+        }
+        if (status == 1)
+        {
+            auto self = shared_from_this();
+            m_socket.async_wait(tcp::socket::wait_write,
+                                [self](const boost::system::error_code &ec)
+                                {
+                                    if (ec)
+                                    {
+                                        // The query is half done; the connection cannot be reused
+                                        self->m_broken = true;
+                                        self->finish(std::make_exception_ptr(std::runtime_error(ec.message())));
+                                        return;
+                                    }
+                                    self->flush();
+                                });
+            return;
+        }
+        readResults();
+    }
+
+    void readResults()
+    {
+        if (!PQconsumeInput(m_conn))
+        {
+            finish(connectionError("Failed to read query result"));
+            return;
+        }
+
+        while (!PQisBusy(m_conn))
+        {
+            PGresult *result = PQgetResult(m_conn);
+            if (!result)
+            {
+                finish(m_error.empty() ? nullptr : std::make_exception_ptr(std::runtime_error(m_error)));
+                return;
+            }
+
+            ExecStatusType status = PQresultStatus(result);
+            if (status == PGRES_TUPLES_OK || status == PGRES_COMMAND_OK)
+            {
+                m_result = AsyncQueryResult(result);
+            }
+            else
+            {
+                m_error = PQresultErrorMessage(result);
+                PQclear(result);
+            }
+        }
+
+        auto self = shared_from_this();
+        m_socket.async_wait(tcp::socket::wait_read,
+                            [self](const boost::system::error_code &ec)
+                            {
+                                if (ec)
+                                {
+                                    // The query is half done; the connection cannot be reused
+                                    self->m_broken = true;
+                                    self->finish(std::make_exception_ptr(std::runtime_error(ec.message())));
+                                    return;
+                                }
+                                self->readResults();
+                            });
+    }
+
+    void finish(std::exception_ptr error)
+    {
+        auto callback = std::move(m_query.callback);
+        auto result = std::move(m_result);
+        auto onFinished = std::move(m_onFinished);
+        m_query = PendingQuery();
+
+        try
+        {
+            callback(error, result);
+        }
+        catch (const std::exception &e)
+        {
+            Logger::error({"Unhandled exception in async query callback: " + std::string(e.what())});
+        }
+
+        onFinished(connected());
+    }
+
+    std::exception_ptr connectionError(const std::string &context)
+    {
+        return std::make_exception_ptr(std::runtime_error(context + ": " + PQerrorMessage(m_conn)));
+    }
+
+    AsyncDatabase &m_owner;
+    PGconn *m_conn = nullptr;
+    tcp::socket m_socket;
+    net::steady_timer m_reconnectTimer;
+    std::string m_connectionString;
+    PendingQuery m_query;
+    AsyncQueryResult m_result;
+    std::string m_error;
+    std::function<void(bool)> m_onFinished;
+    bool m_broken = false;
+    bool m_stopped = false;
+};
+
+void AsyncDatabase::initialize(net::io_context &ioContext, size_t connectionCount)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_initialized)
+    {
+        return;
+    }
+
+    m_strand = std::make_unique<net::strand<net::io_context::executor_type>>(ioContext.get_executor());
+
+    // The first connections are made here, before the io_context runs, so
+    // that a bad configuration fails startup instead of every request
+    std::string connectionString = AppConfig::getInstance().getDatabaseConnectionString();
+    try
+    {
+        for (size_t i = 0; i < connectionCount; i++)
+        {
+            auto connection = std::make_shared<Connection>(*this, connectionString);
+            m_connections.push_back(connection);
+            m_idle.push_back(connection);
+        }
+    }
+    catch (const std::exception &)
+    {
+        // Don't leave half a pool behind holding sockets on the io_context
+        m_idle.clear();
+        m_connections.clear();
+        throw;
+    }
+
+    m_connected = connectionCount;
+    m_initialized = true;
+    Logger::info({"Async database initialized with " + std::to_string(connectionCount) + " connections"});
+}
+
+void AsyncDatabase::query(std::string sql, std::vector<std::string> params, AsyncQueryCallback callback)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (!m_initialized)
+    {
+        lock.unlock();
+        callback(std::make_exception_ptr(std::runtime_error("AsyncDatabase not initialized")), AsyncQueryResult());
+        return;
+    }
+
+    net::post(*m_strand,
+              [this, query = PendingQuery{std::move(sql), std::move(params), std::move(callback)}]() mutable
+              {
+                  m_pending.push_back(std::move(query));
+                  dispatch();
+              });
+}
+
+void AsyncDatabase::dispatch()
+{
+    while (!m_idle.empty() && !m_pending.empty())
+    {
+        auto connection = m_idle.back();
+        m_idle.pop_back();
+
+        // An idle connection only notices it was dropped when used
+        if (!connection->connected())
+        {
+            lose(connection);
+            continue;
+        }
+
+        auto query = std::move(m_pending.front());
+        m_pending.pop_front();
+
+        connection->execute(std::move(query), [this, connection](bool connected)
+                            {
+                                if (connected)
+                                {
+                                    m_idle.push_back(connection);
+                                }
+                                else
+                                {
+                                    lose(connection);
+                                }
+                                dispatch();
+                            });
+    }
+
+    // With every connection down, queued queries would only wait out the
+    // reconnect attempts; fail them now so requests get a prompt error
+    if (m_connected == 0)
+    {
+        auto error = std::make_exception_ptr(std::runtime_error("Database unavailable"));
+        while (!m_pending.empty())
+        {
+            auto query = std::move(m_pending.front());
+            m_pending.pop_front();
+            try
+            {
+                query.callback(error, AsyncQueryResult());
+            }
+            catch (const std::exception &e)
+            {
+                Logger::error({"Unhandled exception in async query callback: " + std::string(e.what())});
+            }
+        }
+    }
+}
+
+void AsyncDatabase::lose(const std::shared_ptr<Connection> &connection)
+{
+    Logger::warn({"Async database connection lost, reconnecting"});
+    m_connected--;
+    connection->reconnect();
+}
+
+void AsyncDatabase::restore(const std::shared_ptr<Connection> &connection)
+{
+    m_connected++;
+    m_idle.push_back(connection);
+    dispatch();
+}
+
+void AsyncDatabase::shutdown()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_initialized)
+    {
+        return;
+    }
+
+    for (auto &connection : m_connections)
+    {
+        connection->stop();
+    }
+    m_idle.clear();
+    m_pending.clear();
+    m_connections.clear();
+    m_connected = 0;
+    m_initialized = false;
+}
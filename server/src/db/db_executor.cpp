@@ -0,0 +1,91 @@
+#include "db/db_executor.hpp"
+#include "utils/logger.hpp"
+#include <algorithm>
+#include <exception>
+#include <string>
+
+void DatabaseExecutor::start(std::size_t threadCount, std::size_t queueCapacity)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_running)
+    {
+        return;
+    }
+
+    m_queueCapacity = queueCapacity;
+    m_running = true;
+    threadCount = std::max<std::size_t>(1, threadCount);
+    for (std::size_t i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back([this]()
+                               { workerLoop(); });
+    }
+
+    Logger::info({"Database executor started with " + std::to_string(threadCount) + " workers"});
+}
+
+bool DatabaseExecutor::post(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running || m_tasks.size() >= m_queueCapacity)
+        {
+            return false;
+        }
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+    return true;
+}
+
+void DatabaseExecutor::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+        {
+            return;
+        }
+        m_running = false;
+    }
+    m_condition.notify_all();
+
+    for (auto &worker : m_workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+    m_workers.clear();
+    m_tasks.clear();
+}
+
+void DatabaseExecutor::workerLoop()
+{
+    while (true)
+    {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]()
+                             { return !m_running || !m_tasks.empty(); });
+            if (!m_running)
+            {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        try
+        {
+            task();
+        }
+        catch (const std::exception &e)
+        {
+            Logger::error({"Unhandled exception in database task: " + std::string(e.what())});
+        }
+    }
+}
@@ -1,9 +1,51 @@
 #include "db/db_manager.hpp"
+#include "db/prepared_statements.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <random>
 #include <stdexcept>
 #include <iostream>
 #include "utils/logger.hpp"
 
-void DatabaseManager::initialize(size_t poolSize)
+ConnectionLease::ConnectionLease(ConnectionLease &&other) noexcept
+    : m_manager(other.m_manager), m_connection(std::move(other.m_connection))
+{
+    other.m_manager = nullptr;
+}
+
+ConnectionLease &ConnectionLease::operator=(ConnectionLease &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_manager = other.m_manager;
+        m_connection = std::move(other.m_connection);
+        other.m_manager = nullptr;
+    }
+    return *this;
+}
+
+std::string ConnectionLease::prepare(const std::string &name)
+{
+    if (m_connection->preparedStatements.count(name) == 0)
+    {
+        m_connection->connection.prepare(name, PreparedStatements::sql(name));
+        m_connection->preparedStatements.insert(name);
+    }
+    return name;
+}
+
+void ConnectionLease::release()
+{
+    if (m_manager && m_connection)
+    {
+        m_manager->releaseConnection(std::move(m_connection));
+    }
+    m_manager = nullptr;
+    m_connection.reset();
+}
+
+void DatabaseManager::initialize(size_t poolSize, size_t maxPoolSize, std::chrono::milliseconds acquireTimeout)
 {
     std::lock_guard<std::mutex> lock(m_mutex);
 
@@ -12,15 +54,25 @@ void DatabaseManager::initialize(size_t poolSize)
         return;
     }
 
+    m_maxPoolSize = std::max(poolSize, maxPoolSize);
+    m_acquireTimeout = acquireTimeout;
+
+    std::random_device random;
+    char instanceId[17];
+    std::snprintf(instanceId, sizeof(instanceId), "%08x%08x", random(), random());
+    m_instanceId = instanceId;
+
     try
     {
         for (size_t i = 0; i < poolSize; i++)
         {
             m_connectionPool.push(createConnection());
+            m_openConnections++;
         }
 
         m_initialized = true;
-        Logger::info({"Database connection pool initialized with " + std::to_string(poolSize) + " connections"});
+        Logger::info({"Database connection pool initialized with " + std::to_string(poolSize) +
+                      " connections (max " + std::to_string(m_maxPoolSize) + ")"});
     }
     catch (const std::exception &e)
     {
@@ -29,107 +81,195 @@ void DatabaseManager::initialize(size_t poolSize)
     }
 }
 
-std::shared_ptr<pqxx::connection> DatabaseManager::getConnection()
+ConnectionLease DatabaseManager::getConnection()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    return getConnection(m_acquireTimeout);
+}
+
+ConnectionLease DatabaseManager::getConnection(std::chrono::milliseconds timeout)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(m_mutex);
 
     if (!m_initialized)
     {
         throw std::runtime_error("DatabaseManager not initialized");
     }
 
-    if (m_connectionPool.empty())
+    bool ready = m_available.wait_for(lock, timeout, [this]()
+                                      { return !m_initialized || !m_connectionPool.empty() || m_openConnections < m_maxPoolSize; });
+    if (!m_initialized)
     {
-        return createConnection();
+        throw std::runtime_error("DatabaseManager not initialized");
+    }
+    if (!ready)
+    {
+        m_metrics.timeouts++;
+        throw std::runtime_error("Timed out waiting for a database connection");
     }
 
-    auto connection = m_connectionPool.front();
-    m_connectionPool.pop();
+    std::shared_ptr<PooledConnection> connection;
+    if (!m_connectionPool.empty())
+    {
+        connection = m_connectionPool.front();
+        m_connectionPool.pop();
+    }
+    else
+    {
+        // Reserve the slot before connecting so the limit holds while the
+        // lock is released.
+        m_openConnections++;
+    }
+    lock.unlock();
 
     try
     {
-        if (!connection->is_open())
+        if (!connection || !connection->connection.is_open())
         {
             connection = createConnection();
         }
     }
     catch (const std::exception &)
     {
-        connection = createConnection();
+        lock.lock();
+        m_openConnections--;
+        lock.unlock();
+        m_available.notify_one();
+        throw;
     }
 
-    return connection;
+    auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    lock.lock();
+    m_metrics.acquisitions++;
+    m_metrics.totalAcquireMicros += waited;
+    m_metrics.maxAcquireMicros = std::max<uint64_t>(m_metrics.maxAcquireMicros, waited);
+
+    return ConnectionLease(this, connection);
 }
 
-void DatabaseManager::releaseConnection(std::shared_ptr<pqxx::connection> connection)
+void DatabaseManager::releaseConnection(std::shared_ptr<PooledConnection> connection)
 {
     if (!connection)
     {
         return;
     }
 
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    if (!m_initialized)
     {
-        throw std::runtime_error("DatabaseManager not initialized");
-    }
+        std::lock_guard<std::mutex> lock(m_mutex);
 
-    try
-    {
+        if (!m_initialized)
+        {
+            return;
+        }
 
-        if (connection->is_open())
+        try
         {
-            m_connectionPool.push(connection);
+            if (connection->connection.is_open())
+            {
+                m_connectionPool.push(connection);
+            }
+            else
+            {
+                m_openConnections--;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            m_openConnections--;
+            std::cerr << "Error releasing connection to pool: " << e.what() << std::endl;
         }
     }
-    catch (const std::exception &e)
-    {
-        std::cerr << "Error releasing connection to pool: " << e.what() << std::endl;
-    }
+
+    m_available.notify_one();
 }
 
-void DatabaseManager::shutdown()
+PoolMetrics DatabaseManager::getMetrics()
 {
     std::lock_guard<std::mutex> lock(m_mutex);
 
-    if (!m_initialized)
+    PoolMetrics metrics = m_metrics;
+    metrics.maxSize = m_maxPoolSize;
+    metrics.openConnections = m_openConnections;
+    metrics.idle = m_connectionPool.size();
+    metrics.inUse = m_openConnections - m_connectionPool.size();
+    return metrics;
+}
+
+void DatabaseManager::listen(net::io_context &ioContext, const std::vector<std::string> &channels,
+                             NotificationHandler handler, std::function<void()> onReset)
+{
+    auto listener = std::make_shared<NotificationListener>(
+        ioContext, AppConfig::getInstance().getDatabaseConnectionString(),
+        channels, std::move(handler), std::move(onReset));
+    listener->start();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_listener)
     {
-        return;
+        m_listener->stop();
     }
+    m_listener = listener;
+}
 
-    while (!m_connectionPool.empty())
+void DatabaseManager::shutdown()
+{
     {
-        auto connection = m_connectionPool.front();
-        m_connectionPool.pop();
+        std::lock_guard<std::mutex> lock(m_mutex);
 
-        try
+        if (m_listener)
         {
-            if (connection->is_open())
-            {
-                connection->close();
-            }
+            m_listener->stop();
+            m_listener.reset();
         }
-        catch (const std::exception &e)
+
+        if (!m_initialized)
         {
-            std::cerr << "Error disconnecting database connection: " << e.what() << std::endl;
+            return;
         }
+
+        while (!m_connectionPool.empty())
+        {
+            auto connection = m_connectionPool.front();
+            m_connectionPool.pop();
+
+            try
+            {
+                if (connection->connection.is_open())
+                {
+                    connection->connection.close();
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error disconnecting database connection: " << e.what() << std::endl;
+            }
+        }
+
+        m_openConnections = 0;
+        m_initialized = false;
     }
 
-    m_initialized = false;
+    m_available.notify_all();
 }
 
-std::shared_ptr<pqxx::connection> DatabaseManager::createConnection()
+std::shared_ptr<PooledConnection> DatabaseManager::createConnection()
 {
     try
     {
         auto &config = AppConfig::getInstance();
-        return std::make_shared<pqxx::connection>(
+        auto connection = std::make_shared<PooledConnection>(
             config.getDatabaseConnectionString());
+
+        // Read by the notification and history triggers
+        pqxx::nontransaction txn(connection->connection);
+        txn.exec_params("SELECT set_config('app.instance_id', $1, false), "
+                        "set_config('app.document_snapshot_interval', $2, false)",
+                        m_instanceId, std::to_string(std::max(1, config.getDocumentSnapshotInterval())));
+        return connection;
     }
     catch (const std::exception &e)
     {
         throw std::runtime_error(
             std::string("Failed to create database connection: ") + e.what());
     }
-}
\ No newline at end of file
+}
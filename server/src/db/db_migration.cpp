@@ -1,9 +1,11 @@
 #include "db/db_migration.hpp"
 #include "utils/logger.hpp"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <utils/sqlbuilder.hpp>
+#include "db/query_params.hpp"
 
 namespace fs = std::filesystem;
 
@@ -45,33 +47,42 @@ void DatabaseMigration::runMigrations()
             }
         }
 
-        // Now execute migrations from build directory
+        // directory_iterator order is unspecified and later migrations build
+        // on earlier ones, so run them in filename order
+        std::vector<fs::path> migrationFiles;
         for (const auto &entry : fs::directory_iterator(buildMigrationsPath))
         {
             if (entry.path().extension() == ".sql")
             {
-                std::string filename = entry.path().filename().string();
-                try
+                migrationFiles.push_back(entry.path());
+            }
+        }
+        std::sort(migrationFiles.begin(), migrationFiles.end());
+
+        // Now execute migrations from build directory
+        for (const auto &path : migrationFiles)
+        {
+            std::string filename = path.filename().string();
+            try
+            {
+                if (!hasMigrationBeenExecuted(*conn, filename))
                 {
-                    if (!hasMigrationBeenExecuted(*conn, filename))
-                    {
-                        Logger::info({"Executing migration: " + filename});
-                        std::string sql = readMigrationFile(entry.path().string());
-                        executeMigration(*conn, sql);
-                        recordMigration(*conn, filename);
-                        Logger::info({"Successfully executed migration: " + filename});
-                    }
-                    else
-                    {
-                        Logger::debug({"Skipping already executed migration: " + filename});
-                    }
+                    Logger::info({"Executing migration: " + filename});
+                    std::string sql = readMigrationFile(path.string());
+                    executeMigration(*conn, sql);
+                    recordMigration(*conn, filename);
+                    Logger::info({"Successfully executed migration: " + filename});
                 }
-                catch (const std::exception &e)
+                else
                 {
-                    Logger::error({"Failed to execute migration " + filename + ": " + e.what()});
-                    throw;
+                    Logger::debug({"Skipping already executed migration: " + filename});
                 }
             }
+            catch (const std::exception &e)
+            {
+                Logger::error({"Failed to execute migration " + filename + ": " + e.what()});
+                throw;
+            }
         }
     }
     catch (const std::exception &e)
@@ -122,8 +133,8 @@ bool DatabaseMigration::hasMigrationBeenExecuted(pqxx::connection &conn, const s
     {
         pqxx::work txn(conn);
         SQLBuilder builder;
-        std::string query = builder.select({"COUNT(*)"}).from("migrations").where({{"filename", filename, "="}}).build();
-        auto result = txn.exec_params(query);
+        auto query = builder.select({"COUNT(*)"}).from("migrations").where({{"filename", filename, "=", {}}}).buildParameterized();
+        auto result = txn.exec_params(query.sql, toPqxxParams(query.params));
         txn.commit();
         if (result.empty() || result[0].empty())
         {
@@ -146,8 +157,8 @@ void DatabaseMigration::recordMigration(pqxx::connection &conn, const std::strin
     {
         pqxx::work txn(conn);
         SQLBuilder builder;
-        std::string query = builder.insert("migrations", {"filename"}, {filename}).build();
-        txn.exec_params(query);
+        auto query = builder.insert("migrations", {"filename"}, {filename}).buildParameterized();
+        txn.exec_params(query.sql, toPqxxParams(query.params));
         txn.commit();
         Logger::debug({"Recorded migration execution: " + filename});
     }
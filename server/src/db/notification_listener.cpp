@@ -0,0 +1,299 @@
+#include "db/notification_listener.hpp"
+#include "db/async_connector.hpp"
+#include "config/app_config.hpp"
+#include "utils/logger.hpp"
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <chrono>
+#include <stdexcept>
+
+using tcp = net::ip::tcp;
+
+NotificationListener::NotificationListener(net::io_context &ioContext, std::string connectionString,
+                                           std::vector<std::string> channels,
+                                           NotificationHandler handler, std::function<void()> onReset)
+    : m_socket(net::make_strand(ioContext)),
+      m_reconnectTimer(m_socket.get_executor()),
+      m_connectionString(std::move(connectionString)),
+      m_channels(std::move(channels)),
+      m_handler(std::move(handler)),
+      m_onReset(std::move(onReset))
+{
+}
+
+void NotificationListener::start()
+{
+    connect();
+    waitForNotifications();
+    Logger::info({"Listening for database notifications on " + std::to_string(m_channels.size()) + " channels"});
+}
+
+void NotificationListener::stop()
+{
+    // Runs on the io_context so it never races a pending wait handler
+    auto self = shared_from_this();
+    net::post(m_socket.get_executor(), [self]()
+              {
+                  self->m_stopped = true;
+                  self->m_reconnectTimer.cancel();
+                  self->close(); });
+}
+
+void NotificationListener::connect()
+{
+    m_conn = PQconnectdb(m_connectionString.c_str());
+    if (PQstatus(m_conn) != CONNECTION_OK)
+    {
+        std::string message = PQerrorMessage(m_conn);
+        close();
+        throw std::runtime_error("Failed to create listener connection: " + message);
+    }
+
+    std::string command = listenCommand();
+    PGresult *result = PQexec(m_conn, command.c_str());
+    bool ok = PQresultStatus(result) == PGRES_COMMAND_OK;
+    PQclear(result);
+    if (!ok)
+    {
+        std::string message = PQerrorMessage(m_conn);
+        close();
+        throw std::runtime_error("Failed to LISTEN: " + message);
+    }
+
+    if (PQsetnonblocking(m_conn, 1) != 0)
+    {
+        close();
+        throw std::runtime_error("Failed to switch listener connection to non-blocking mode");
+    }
+    m_socket.assign(tcp::v4(), PQsocket(m_conn));
+}
+
+std::string NotificationListener::listenCommand()
+{
+    std::string command;
+    for (const auto &channel : m_channels)
+    {
+        char *identifier = PQescapeIdentifier(m_conn, channel.c_str(), channel.size());
+        if (!identifier)
+        {
+            std::string message = PQerrorMessage(m_conn);
+            close();
+            throw std::runtime_error("Invalid notification channel " + channel + ": " + message);
+        }
+        command += "LISTEN " + std::string(identifier) + ";";
+        PQfreemem(identifier);
+    }
+    return command;
+}
+
+void NotificationListener::close()
+{
+    if (m_socket.is_open())
+    {
+        m_socket.release();
+    }
+    if (m_conn)
+    {
+        PQfinish(m_conn);
+        m_conn = nullptr;
+    }
+}
+
+void NotificationListener::waitForNotifications()
+{
+    auto self = shared_from_this();
+    m_socket.async_wait(tcp::socket::wait_read,
+                        [self](const boost::system::error_code &ec)
+                        {
+                            if (self->m_stopped)
+                            {
+                                return;
+                            }
+                            if (ec)
+                            {
+                                Logger::warn({"Listener connection wait failed: " + ec.message()});
+                                self->scheduleReconnect();
+                                return;
+                            }
+                            self->readNotifications();
+                        });
+}
+
+void NotificationListener::readNotifications()
+{
+    if (!PQconsumeInput(m_conn) || PQstatus(m_conn) != CONNECTION_OK)
+    {
+        Logger::warn({"Listener connection lost: " + std::string(PQerrorMessage(m_conn))});
+        scheduleReconnect();
+        return;
+    }
+
+    while (PGnotify *notification = PQnotifies(m_conn))
+    {
+        std::string channel = notification->relname;
+        std::string payload = notification->extra;
+        PQfreemem(notification);
+
+        try
+        {
+            m_handler(channel, payload);
+        }
+        catch (const std::exception &e)
+        {
+            Logger::error({"Unhandled exception in notification handler: " + std::string(e.what())});
+        }
+    }
+
+    waitForNotifications();
+}
+
+void NotificationListener::scheduleReconnect()
+{
+    close();
+
+    auto self = shared_from_this();
+    m_reconnectTimer.expires_after(std::chrono::milliseconds(AppConfig::getInstance().getDatabaseReconnectDelayMs()));
+    m_reconnectTimer.async_wait([self](const boost::system::error_code &ec)
+                                {
+                                    if (ec || self->m_stopped)
+                                    {
+                                        return;
+                                    }
+                                    self->reconnect(); });
+}
+
+// Runs on the io_context alongside HTTP sessions, so nothing here may block:
+// the connection is polled open and the LISTEN commands are sent and read
+// back asynchronously.
+void NotificationListener::reconnect()
+{
+    auto self = shared_from_this();
+    AsyncConnector::connect(
+        m_socket, m_connectionString,
+        std::chrono::milliseconds(AppConfig::getInstance().getDatabaseConnectTimeoutMs()),
+        [self](PGconn *conn, const std::string &error)
+        {
+            if (self->m_stopped)
+            {
+                if (conn)
+                {
+                    boost::system::error_code ignored;
+                    self->m_socket.release(ignored);
+                    PQfinish(conn);
+                }
+                return;
+            }
+            if (!conn)
+            {
+                Logger::warn({"Listener reconnect failed: " + error});
+                self->scheduleReconnect();
+                return;
+            }
+
+            self->m_conn = conn;
+            std::string command;
+            try
+            {
+                command = self->listenCommand();
+            }
+            catch (const std::exception &e)
+            {
+                Logger::warn({e.what()});
+                self->scheduleReconnect();
+                return;
+            }
+            if (!PQsendQuery(self->m_conn, command.c_str()))
+            {
+                Logger::warn({"Failed to send LISTEN: " + std::string(PQerrorMessage(self->m_conn))});
+                self->scheduleReconnect();
+                return;
+            }
+            self->flushSubscription();
+        });
+}
+
+void NotificationListener::flushSubscription()
+{
+    int status = PQflush(m_conn);
+    if (status < 0)
+    {
+        Logger::warn({"Failed to send LISTEN: " + std::string(PQerrorMessage(m_conn))});
+        scheduleReconnect();
+        return;
+    }
+    if (status == 0)
+    {
+        readSubscription();
+        return;
+    }
+
+    auto self = shared_from_this();
+    m_socket.async_wait(tcp::socket::wait_write,
+                        [self](const boost::system::error_code &ec)
+                        {
+                            if (self->m_stopped)
+                            {
+                                return;
+                            }
+                            if (ec)
+                            {
+                                Logger::warn({"Listener connection wait failed: " + ec.message()});
+                                self->scheduleReconnect();
+                                return;
+                            }
+                            self->flushSubscription();
+                        });
+}
+
+void NotificationListener::readSubscription()
+{
+    if (!PQconsumeInput(m_conn))
+    {
+        Logger::warn({"Listener connection lost: " + std::string(PQerrorMessage(m_conn))});
+        scheduleReconnect();
+        return;
+    }
+
+    while (!PQisBusy(m_conn))
+    {
+        PGresult *result = PQgetResult(m_conn);
+        if (!result)
+        {
+            Logger::info({"Listener connection re-established"});
+            if (m_onReset)
+            {
+                m_onReset();
+            }
+            // Notifications may already sit in libpq's buffer, where the
+            // socket wait would not see them
+            readNotifications();
+            return;
+        }
+
+        bool ok = PQresultStatus(result) == PGRES_COMMAND_OK;
+        PQclear(result);
+        if (!ok)
+        {
+            Logger::warn({"Failed to LISTEN: " + std::string(PQerrorMessage(m_conn))});
+            scheduleReconnect();
+            return;
+        }
+    }
+
+    auto self = shared_from_this();
+    m_socket.async_wait(tcp::socket::wait_read,
+                        [self](const boost::system::error_code &ec)
+                        {
+                            if (self->m_stopped)
+                            {
+                                return;
+                            }
+                            if (ec)
+                            {
+                                Logger::warn({"Listener connection wait failed: " + ec.message()});
+                                self->scheduleReconnect();
+                                return;
+                            }
+                            self->readSubscription();
+                        });
+}
@@ -0,0 +1,140 @@
+#include "db/prepared_statements.hpp"
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+    const std::unordered_map<std::string, std::string> &registry()
+    {
+        static const std::unordered_map<std::string, std::string> statements = {
+            {PreparedStatements::DOCUMENT_FIND_BY_ID,
+             "SELECT * FROM documents WHERE id = $1"},
+            {PreparedStatements::DOCUMENT_INSERT,
+             "INSERT INTO documents (title, content, created_at, updated_at, is_public, author_id) "
+             "VALUES ($1, $2, to_timestamp($3), to_timestamp($4), $5, NULLIF($6::integer, -1)) "
+             "RETURNING id, author_id, version"},
+            // NULL parameters keep the stored value ($5 = -1 clears the
+            // author); $6 is the version the row must still have, or NULL
+            {PreparedStatements::DOCUMENT_UPDATE,
+             "UPDATE documents SET title = coalesce($2, title), content = coalesce($3, content), "
+             "is_public = coalesce($4, is_public), "
+             "author_id = CASE WHEN $5::integer IS NULL THEN author_id ELSE NULLIF($5::integer, -1) END "
+             "WHERE id = $1 AND ($6::integer IS NULL OR version = $6::integer) "
+             "RETURNING id, title, author_id, created_at, updated_at, is_public, version"},
+            {PreparedStatements::DOCUMENT_DELETE,
+             "DELETE FROM documents WHERE id = $1 AND ($2::integer IS NULL OR version = $2::integer) RETURNING id"},
+            {PreparedStatements::DOCUMENT_CURRENT_VERSION,
+             "SELECT version FROM documents WHERE id = $1"},
+            {PreparedStatements::DOCUMENT_LOCK_FOR_EDIT,
+             "SELECT version, char_length(coalesce(content, '')) AS length FROM documents WHERE id = $1 FOR UPDATE"},
+            // $2 is the 1-based first character and $3 the character count
+            {PreparedStatements::DOCUMENT_CONTENT_SPAN,
+             "SELECT substr(coalesce(content, ''), $2, $3) AS span FROM documents WHERE id = $1"},
+            {PreparedStatements::DOCUMENT_REPLACE_SPAN,
+             "UPDATE documents SET content = overlay(coalesce(content, '') placing $2 from $3 for $4), "
+             "version = version + 1 WHERE id = $1 "
+             "RETURNING id, title, author_id, created_at, updated_at, is_public, version"},
+            // Newest $2 documents of each author in $1, metadata only
+            {PreparedStatements::DOCUMENTS_BY_AUTHORS,
+             "SELECT id, title, author_id, created_at, updated_at, is_public, version FROM ("
+             "SELECT id, title, author_id, created_at, updated_at, is_public, version, "
+             "row_number() OVER (PARTITION BY author_id ORDER BY id DESC) AS position "
+             "FROM documents WHERE author_id = ANY($1::integer[])) ranked "
+             "WHERE position <= $2 ORDER BY author_id, id DESC"},
+            // $1 author id, $2 last id of the previous page or NULL, $3 page size,
+            // $4 whether private documents are included
+            {PreparedStatements::DOCUMENTS_PAGE_BY_AUTHOR,
+             "SELECT id, title, author_id, created_at, updated_at, is_public, version FROM documents "
+             "WHERE author_id = $1 AND ($2::integer IS NULL OR id < $2::integer) AND ($4 OR is_public) "
+             "ORDER BY id DESC LIMIT $3"},
+            {PreparedStatements::DOCUMENTS_ASSIGN_AUTHOR,
+             "UPDATE documents SET author_id = $1 WHERE id = ANY($2::integer[]) AND author_id IS DISTINCT FROM $1 "
+             "RETURNING id, version, extract(epoch FROM updated_at)::bigint AS updated_at"},
+            {PreparedStatements::DOCUMENTS_DELETE_BY_AUTHOR,
+             "DELETE FROM documents WHERE author_id = $1 RETURNING id"},
+            // $1 query, $2 author id or -1, $3 include private, $4/$5 cursor
+            // (rank, id) or NULL, $6 page size
+            {PreparedStatements::DOCUMENT_SEARCH,
+             "SELECT d.id, d.title, d.author_id, d.created_at, d.updated_at, d.is_public, d.version, "
+             "ts_rank(d.search_vector, q.query) AS rank "
+             "FROM documents d, websearch_to_tsquery('english', $1) AS q(query) "
+             "WHERE d.search_vector @@ q.query "
+             "AND ($2::integer = -1 OR d.author_id = $2::integer) "
+             "AND ($3::boolean OR d.is_public) "
+             "AND ($4::real IS NULL OR (ts_rank(d.search_vector, q.query), d.id) < ($4::real, $5::integer)) "
+             "ORDER BY rank DESC, d.id DESC "
+             "LIMIT $6"},
+            // Search index (re)building; timestamps as epoch seconds
+            {PreparedStatements::DOCUMENTS_INDEX_BATCH,
+             "SELECT id, title, content, author_id, is_public, version, "
+             "extract(epoch FROM created_at)::bigint AS created_at, "
+             "extract(epoch FROM updated_at)::bigint AS updated_at "
+             "FROM documents WHERE id > $1 ORDER BY id LIMIT $2"},
+            {PreparedStatements::DOCUMENTS_INDEX_BY_IDS,
+             "SELECT id, title, content, author_id, is_public, version, "
+             "extract(epoch FROM created_at)::bigint AS created_at, "
+             "extract(epoch FROM updated_at)::bigint AS updated_at "
+             "FROM documents WHERE id = ANY($1::integer[])"},
+            {PreparedStatements::DOCUMENT_INDEX_VERSIONS,
+             "SELECT id, version FROM documents"},
+
+            // Copies the current content server-side instead of shipping it.
+            // It replaces the empty delta the history trigger writes when an
+            // update leaves the content unchanged.
+            {PreparedStatements::DOCUMENT_VERSION_SNAPSHOT,
+             "INSERT INTO document_versions (document_id, version, snapshot) "
+             "SELECT id, version, coalesce(content, '') FROM documents WHERE id = $1 "
+             "ON CONFLICT (document_id, version) DO UPDATE SET snapshot = EXCLUDED.snapshot, delta = NULL"},
+            {PreparedStatements::DOCUMENT_VERSION_DELTA,
+             "INSERT INTO document_versions (document_id, version, delta) VALUES ($1, $2, $3) "
+             "ON CONFLICT (document_id, version) DO NOTHING"},
+            // Nearest snapshot at or before version $2 and every delta after it
+            {PreparedStatements::DOCUMENT_VERSION_CHAIN,
+             "SELECT version, snapshot, delta, extract(epoch FROM created_at)::bigint AS created_at "
+             "FROM document_versions WHERE document_id = $1 AND version <= $2 AND version >= ("
+             "SELECT max(version) FROM document_versions "
+             "WHERE document_id = $1 AND version <= $2 AND snapshot IS NOT NULL) "
+             "ORDER BY version"},
+            // $1 document id, $2 versions below this or NULL, $3 page size
+            {PreparedStatements::DOCUMENT_VERSIONS_PAGE,
+             "SELECT version, snapshot IS NOT NULL AS is_snapshot, "
+             "coalesce(octet_length(snapshot), octet_length(delta)) AS bytes, "
+             "extract(epoch FROM created_at)::bigint AS created_at "
+             "FROM document_versions WHERE document_id = $1 AND ($2::integer IS NULL OR version < $2::integer) "
+             "ORDER BY version DESC LIMIT $3"},
+
+            {PreparedStatements::AUTHOR_FIND_BY_ID,
+             "SELECT * FROM authors WHERE id = $1"},
+            {PreparedStatements::AUTHOR_FIND_BY_EMAIL,
+             "SELECT * FROM authors WHERE email = $1"},
+            {PreparedStatements::AUTHOR_SEARCH_BY_NAME,
+             "SELECT * FROM authors WHERE name LIKE '%' || $1 || '%'"},
+            {PreparedStatements::AUTHOR_ALL,
+             "SELECT * FROM authors WHERE is_deleted = false"},
+            {PreparedStatements::AUTHOR_INSERT,
+             "INSERT INTO authors (name, email, password) VALUES ($1, $2, $3) RETURNING id"},
+            {PreparedStatements::AUTHOR_UPDATE,
+             "UPDATE authors SET name = $2, email = $3, password = $4, is_deleted = $5 WHERE id = $1"},
+            {PreparedStatements::AUTHOR_SOFT_DELETE,
+             "UPDATE authors SET is_deleted = true WHERE id = $1"},
+            // Changes whenever the profile response would: the author row or
+            // the id/version of any document on its first page ($2 rows)
+            {PreparedStatements::AUTHOR_PROFILE_FINGERPRINT,
+             "SELECT md5(a.id || ':' || a.updated_at::text || ':' || coalesce(("
+             "SELECT string_agg(d.id || '.' || d.version, ',' ORDER BY d.id DESC) FROM ("
+             "SELECT id, version FROM documents WHERE author_id = a.id ORDER BY id DESC LIMIT $2) d), '')) AS fingerprint "
+             "FROM authors a WHERE a.id = $1"},
+        };
+        return statements;
+    }
+}
+
+const std::string &PreparedStatements::sql(const std::string &name)
+{
+    auto statement = registry().find(name);
+    if (statement == registry().end())
+    {
+        throw std::invalid_argument("Unknown prepared statement: " + name);
+    }
+    return statement->second;
+}
@@ -1,25 +1,67 @@
 #include <boost/asio.hpp>
 #include <server/http_server.hpp>
 #include <db/db_manager.hpp>
+#include <db/db_executor.hpp>
+#include <db/async_database.hpp>
+#include <services/search_index.hpp>
+#include <services/document_cache.hpp>
+#include <services/collaboration.hpp>
 #include <config/app_config.hpp>
 #include <utils/logger.hpp>
 #include <routes/auth_routes.hpp>
 #include <routes/document_routes.hpp>
 #include <db/db_migration.hpp>
 
+#include <charconv>
+#include <chrono>
 #include <csignal>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
+#include <thread>
 
-std::unique_ptr<HttpServer> g_server;
-
-void signalHandler(int signal)
+// Payloads are "<document id>:<instance id>". Our own writes have already
+// updated the cache and search index, so only other instances' count.
+void onDocumentChanged(const std::string &payload)
 {
-    if (g_server)
+    std::string_view text(payload);
+    std::string_view instance;
+    auto separator = text.find(':');
+    if (separator != std::string_view::npos)
+    {
+        instance = text.substr(separator + 1);
+        text = text.substr(0, separator);
+    }
+
+    int id = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), id);
+    if (ec != std::errc() || end != text.data() + text.size())
+    {
+        Logger::warn({"Ignoring malformed documents_changed payload: " + payload});
+        return;
+    }
+    if (instance == DatabaseManager::getInstance().getInstanceId())
     {
-        Logger::warn({"Shutting down server"});
-        g_server->stop();
-        exit(signal);
+        return;
+    }
+
+    DocumentCache::getInstance().invalidate(id);
+    if (SearchIndex::getInstance().isReady())
+    {
+        bool queued = DatabaseExecutor::getInstance().post([id]()
+                                                           {
+            try
+            {
+                SearchIndex::getInstance().refresh(id);
+            }
+            catch (const std::exception &e)
+            {
+                Logger::error({"Failed to refresh document " + std::to_string(id) + " in the search index: " + e.what()});
+            } });
+        if (!queued)
+        {
+            Logger::warn({"Search index refresh for document " + std::to_string(id) + " was not queued"});
+        }
     }
 }
 
@@ -31,8 +73,21 @@ int main()
         Logger::getInstance().setLogLevel(config.isDebugModeEnabled() ? 4 : 3);
         try
         {
-            DatabaseManager::getInstance().initialize(5);
+            DatabaseManager::getInstance().initialize(
+                config.getDatabasePoolSize(),
+                config.getDatabasePoolMaxSize(),
+                std::chrono::milliseconds(config.getDatabaseAcquireTimeoutMs()));
             DatabaseMigration::runMigrations();
+            DatabaseExecutor::getInstance().start(
+                config.getDatabaseWorkerThreads(),
+                config.getDatabaseQueueCapacity());
+            DocumentCache::getInstance().initialize(
+                config.getDocumentCacheBytes(),
+                config.getDocumentCacheShards());
+            if (config.isSearchIndexEnabled())
+            {
+                SearchIndex::getInstance().initialize(config.getSearchIndexSnapshotPath());
+            }
         }
         catch (std::exception &e)
         {
@@ -40,22 +95,118 @@ int main()
             return 1;
         }
 
-        boost::asio::io_context io_context;
+        unsigned int threadCount = config.getServerThreadCount();
+        if (threadCount == 0)
+        {
+            threadCount = std::thread::hardware_concurrency();
+        }
+        bool sharded = config.isIoContextShardingEnabled();
+
+        // A sharded io_context is only ever run by a single thread
+        boost::asio::io_context io_context(sharded ? 1 : BOOST_ASIO_CONCURRENCY_HINT_DEFAULT);
 
-        signal(SIGINT, signalHandler);
-        signal(SIGTERM, signalHandler);
+        // Sharded, every io_context serves its share of connections, so the
+        // async database, the change listener and the collaboration rooms
+        // get a context and thread of their own rather than piling onto the
+        // first shard. Unsharded, they share the server's thread pool.
+        std::unique_ptr<boost::asio::io_context> serviceContext;
+        if (sharded)
+        {
+            serviceContext = std::make_unique<boost::asio::io_context>(1);
+        }
+        boost::asio::io_context &services = sharded ? *serviceContext : io_context;
+
+        try
+        {
+            AsyncDatabase::getInstance().initialize(services, config.getAsyncDatabaseConnections());
+        }
+        catch (std::exception &e)
+        {
+            Logger::error({"Error initializing async database: " + std::string(e.what())});
+            return 1;
+        }
+
+        // Other instances' writes reach us as NOTIFY payloads carrying the
+        // document id; a reconnect may have missed some, so start afresh.
+        try
+        {
+            DatabaseManager::getInstance().listen(
+                services, {"documents_changed"},
+                [](const std::string &, const std::string &payload)
+                {
+                    onDocumentChanged(payload);
+                },
+                []()
+                {
+                    DocumentCache::getInstance().clear();
+                    if (SearchIndex::getInstance().isReady())
+                    {
+                        DatabaseExecutor::getInstance().post([]()
+                                                             {
+                            try
+                            {
+                                SearchIndex::getInstance().reconcile();
+                            }
+                            catch (const std::exception &e)
+                            {
+                                Logger::error({"Failed to reconcile the search index: " + std::string(e.what())});
+                            } });
+                    }
+                });
+        }
+        catch (std::exception &e)
+        {
+            Logger::error({"Error starting database listener: " + std::string(e.what())});
+            return 1;
+        }
+
+        CollaborationManager::getInstance().initialize(services);
 
         // Register routes
         DocumentRoutes::registerRoutes();
         AuthRoutes::registerRoutes();
 
-        g_server = std::make_unique<HttpServer>(
+        auto server = std::make_unique<HttpServer>(
             io_context,
-            config.getPort());
+            config.getPort(),
+            threadCount,
+            sharded,
+            config.isCpuPinningEnabled());
+
+        // The handler only stops the io_contexts; the shutdown below runs on
+        // this thread once run() has returned, where taking locks and
+        // joining threads is safe.
+        boost::asio::signal_set signals(io_context, SIGINT, SIGTERM);
+        signals.async_wait([&server](const boost::system::error_code &ec, int)
+                           {
+                               if (!ec)
+                               {
+                                   Logger::warn({"Shutting down server"});
+                                   server->stop();
+                               } });
 
         Logger::info({"Server starting on port " + std::to_string(config.getPort())});
 
-        g_server->run();
+        std::thread serviceThread;
+        if (serviceContext)
+        {
+            serviceThread = std::thread([&services]()
+                                        {
+                                            auto work = boost::asio::make_work_guard(services);
+                                            services.run(); });
+        }
+
+        server->run();
+
+        if (serviceThread.joinable())
+        {
+            services.stop();
+            serviceThread.join();
+        }
+
+        DatabaseExecutor::getInstance().shutdown();
+        AsyncDatabase::getInstance().shutdown();
+        SearchIndex::getInstance().saveSnapshot();
     }
     catch (const std::exception &e)
     {
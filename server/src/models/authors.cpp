@@ -1,10 +1,14 @@
 #include <models/authors.hpp>
 #include <db/db_manager.hpp>
+#include <db/prepared_statements.hpp>
+#include <db/query_params.hpp>
+#include <services/search_index.hpp>
+#include <services/document_cache.hpp>
 #include <pqxx/pqxx>
 #include <utils/logger.hpp>
-#include <utils/SQLBuilder.hpp>
 #include <stdexcept>
 #include <functional>
+#include <unordered_map>
 
 Author::Author(const std::string &name, const std::string &email, const std::string &password)
     : name(name), email(email), is_deleted(false), password(password)
@@ -35,17 +39,23 @@ void Author::setDeleted(bool status)
 
 bool Author::save()
 {
-    auto conn = DatabaseManager::getInstance().getConnection();
-    pqxx::work txn(*conn);
-    SQLBuilder builder;
     try
     {
+        for (const auto& doc : documents)
+        {
+            if (doc->getId() == -1)
+            {
+                throw std::invalid_argument("Unsaved documents cannot be attached through Author::save");
+            }
+        }
+
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(id == -1 ? PreparedStatements::AUTHOR_INSERT : PreparedStatements::AUTHOR_UPDATE);
+        auto assignDocuments = conn.prepare(PreparedStatements::DOCUMENTS_ASSIGN_AUTHOR);
+        pqxx::work txn(*conn);
         if (id == -1)
         {
-            std::vector<std::string> columns = {"name", "email", "password"};
-            std::vector<std::string> values = {name, email, password};
-            std::string sql = builder.insert("authors", columns, values).returning({"id"}).build();
-            auto result = txn.exec(sql);
+            auto result = txn.exec_prepared(statement, name, email, password);
             if (result.empty() || result[0].empty())
             {
                 throw std::runtime_error("Insert did not return an ID");
@@ -54,27 +64,49 @@ bool Author::save()
         }
         else
         {
-            std::vector<std::pair<std::string, std::string>> updates = {
-                {"name", name},
-                {"email", email},
-                {"password", password}};
-
-            std::string updateSql = builder
-                                        .update("authors")
-                                        .set(updates)
-                                        .where({{"id", std::to_string(id), "="}})
-                                        .build();
+            txn.exec_prepared(statement, id, name, email, password, is_deleted);
+        }
+        // Attach the author's documents in the same transaction. They are
+        // loaded without their content, so only ownership is written here;
+        // documents are created and edited through Document::save.
+        std::vector<int> documentIds;
+        for (const auto& doc : documents)
+        {
+            documentIds.push_back(doc->getId());
+        }
+        pqxx::result assigned;
+        if (!documentIds.empty())
+        {
+            assigned = txn.exec_prepared(assignDocuments, id, toPgArray(documentIds));
+        }
+        txn.commit();
 
-            txn.exec(updateSql);
+        // Documents already owned by the author were left as they are; the
+        // reassigned ones moved to a new version
+        std::unordered_map<int, pqxx::row> moved;
+        for (auto row : assigned)
+        {
+            moved.emplace(row["id"].as<int>(), row);
         }
-        if (id != -1) {
-            // Update existing documents
-            for (const auto& doc : documents) {
-                doc->setAuthorId(id);
-                doc->save();
+        for (const auto& doc : documents)
+        {
+            doc->setAuthorId(id);
+            auto found = moved.find(doc->getId());
+            if (found != moved.end())
+            {
+                doc->version = found->second["version"].as<int>();
+                doc->updated_at = found->second["updated_at"].as<long long>(0);
             }
         }
-        txn.commit();
+        for (int documentId : documentIds)
+        {
+            DocumentCache::getInstance().invalidate(documentId);
+        }
+        for (auto row : assigned)
+        {
+            SearchIndex::getInstance().assignAuthor(row["id"].as<int>(), id, row["version"].as<int>(),
+                                                    row["updated_at"].as<long long>(0));
+        }
         Logger::info({"Author saved successfully with ID: " + std::to_string(id)});
         return true;
     }
@@ -87,19 +119,23 @@ bool Author::save()
 
 bool Author::remove()
 {
-    auto conn = DatabaseManager::getInstance().getConnection();
-    pqxx::work txn(*conn);
-    SQLBuilder builder;
     try
     {
-        std::string sql = builder.query("UPDATE authors SET is_deleted = true WHERE id = " + std::to_string(id)).build();
-        txn.exec(sql);
-        for (const auto& doc : documents)
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto softDelete = conn.prepare(PreparedStatements::AUTHOR_SOFT_DELETE);
+        auto deleteDocuments = conn.prepare(PreparedStatements::DOCUMENTS_DELETE_BY_AUTHOR);
+        pqxx::work txn(*conn);
+        txn.exec_prepared(softDelete, id);
+        auto deleted = txn.exec_prepared(deleteDocuments, id);
+        txn.commit();
+
+        documents.clear();
+        documentsCursor.clear();
+        for (auto row : deleted)
         {
-            std::string deleteDocQuery = builder.deleteFrom("documents").where({{"id", std::to_string(doc->getId()), "="}}).build();
-            txn.exec(deleteDocQuery);
+            DocumentCache::getInstance().invalidate(row["id"].as<int>());
+            SearchIndex::getInstance().remove(row["id"].as<int>());
         }
-        txn.commit();
         Logger::info({"Author removed successfully with ID: " + std::to_string(id)});
         return true;
     }
@@ -116,23 +152,30 @@ std::vector<Author> Author::search(const std::string &query)
     try
     {
         auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::AUTHOR_SEARCH_BY_NAME);
+        auto documentsStatement = conn.prepare(PreparedStatements::DOCUMENTS_BY_AUTHORS);
         pqxx::work txn(*conn);
-        SQLBuilder builder;
-        std::string sql = builder.select({"*"}).from("authors").where({{"name", query, "LIKE"}}).build();
-        auto result = txn.exec(sql);
-        txn.commit();
+        auto result = txn.exec_prepared(statement, query);
         for (auto row : result)
         {
             Author author(row["name"].as<std::string>(), row["email"].as<std::string>(), "");
             author.id = row["id"].as<int>();
             author.is_deleted = row["is_deleted"].as<bool>();
-            author.populateDocuments();
             authors.push_back(author);
         }
+
+        std::vector<Author *> pending;
+        for (auto &author : authors)
+        {
+            pending.push_back(&author);
+        }
+        loadDocuments(txn, documentsStatement, pending);
+        txn.commit();
     }
     catch (const std::exception &e)
     {
         Logger::error({"Failed to search authors: " + std::string(e.what())});
+        authors.clear();
     }
     return authors;
 }
@@ -143,10 +186,9 @@ std::vector<Author> Author::all()
     try
     {
         auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::AUTHOR_ALL);
         pqxx::work txn(*conn);
-        SQLBuilder builder;
-        std::string sql = builder.select({"*"}).from("authors").where({{"is_deleted", "false", "="}}).build();
-        auto result = txn.exec(sql);
+        auto result = txn.exec_prepared(statement);
         txn.commit();
         for (auto row : result)
         {
@@ -168,11 +210,10 @@ Author Author::findById(int id)
     try
     {
         auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::AUTHOR_FIND_BY_ID);
+        auto documentsStatement = conn.prepare(PreparedStatements::DOCUMENTS_BY_AUTHORS);
         pqxx::work txn(*conn);
-        SQLBuilder builder;
-        std::string sql = builder.select({"*"}).from("authors").where({{"id", std::to_string(id), "="}}).build();
-        auto result = txn.exec(sql);
-        txn.commit();
+        auto result = txn.exec_prepared(statement, id);
         if (result.empty() || result[0].empty())
         {
             throw std::runtime_error("Author not found");
@@ -181,7 +222,8 @@ Author Author::findById(int id)
         Author author(row["name"].as<std::string>(), row["email"].as<std::string>(), "");
         author.id = row["id"].as<int>();
         author.is_deleted = row["is_deleted"].as<bool>();
-        author.populateDocuments();
+        loadDocuments(txn, documentsStatement, {&author});
+        txn.commit();
         return author;
     }
     catch (const std::exception &e)
@@ -191,16 +233,37 @@ Author Author::findById(int id)
     }
 }
 
-Author Author::findByEmail(const std::string &email)
+std::optional<std::string> Author::profileFingerprint(int id)
 {
     try
     {
         auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::AUTHOR_PROFILE_FINGERPRINT);
         pqxx::work txn(*conn);
-        SQLBuilder builder;
-        std::string sql = builder.select({"*"}).from("authors").where({{"email", email, "="}}).build();
-        auto result = txn.exec(sql);
+        auto result = txn.exec_prepared(statement, id, DOCUMENTS_PAGE_SIZE + 1);
         txn.commit();
+        if (result.empty())
+        {
+            return std::nullopt;
+        }
+        return result[0]["fingerprint"].as<std::string>();
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to fingerprint author profile: " + std::string(e.what())});
+        return std::nullopt;
+    }
+}
+
+Author Author::findByEmail(const std::string &email)
+{
+    try
+    {
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::AUTHOR_FIND_BY_EMAIL);
+        auto documentsStatement = conn.prepare(PreparedStatements::DOCUMENTS_BY_AUTHORS);
+        pqxx::work txn(*conn);
+        auto result = txn.exec_prepared(statement, email);
         if (result.empty() || result[0].empty())
         {
             throw std::runtime_error("Author not found");
@@ -209,7 +272,8 @@ Author Author::findByEmail(const std::string &email)
         Author author(row["name"].as<std::string>(), row["email"].as<std::string>(), row["password"].as<std::string>());
         author.id = row["id"].as<int>();
         author.is_deleted = row["is_deleted"].as<bool>();
-        author.populateDocuments();
+        loadDocuments(txn, documentsStatement, {&author});
+        txn.commit();
         return author;
     }
     catch (const std::exception &e)
@@ -221,30 +285,55 @@ Author Author::findByEmail(const std::string &email)
 
 const std::vector<std::shared_ptr<Document>>& Author::getDocuments() const
 {
-    if (documents.empty()) {
+    if (!documentsLoaded) {
         const_cast<Author*>(this)->populateDocuments();
     }
     return documents;
 }
 
+const std::string& Author::getDocumentsCursor() const
+{
+    getDocuments();
+    return documentsCursor;
+}
+
 void Author::populateDocuments() {
     auto conn = DatabaseManager::getInstance().getConnection();
+    auto statement = conn.prepare(PreparedStatements::DOCUMENTS_BY_AUTHORS);
     pqxx::work txn(*conn);
-    SQLBuilder builder;
-    std::string sql = builder.select({"*"}).from("documents").where({{"author_id", std::to_string(id), "="}}).build();
-    auto result = txn.exec(sql);
+    loadDocuments(txn, statement, {this});
+    txn.commit();
+}
+
+void Author::loadDocuments(pqxx::transaction_base &txn, const std::string &statement,
+                           const std::vector<Author *> &authors)
+{
+    std::unordered_map<int, Author *> byId;
+    std::vector<int> ids;
+    for (auto *author : authors)
+    {
+        author->documents.clear();
+        author->documentsCursor.clear();
+        author->documentsLoaded = true;
+        if (author->id != -1 && byId.emplace(author->id, author).second)
+        {
+            ids.push_back(author->id);
+        }
+    }
+    if (ids.empty())
+    {
+        return;
+    }
 
-    documents.clear();
+    // One extra row per author tells whether there is a next page
+    auto result = txn.exec_prepared(statement, toPgArray(ids), DOCUMENTS_PAGE_SIZE + 1);
     for (auto row : result) {
-        auto doc = std::make_shared<Document>(
-            row["title"].as<std::string>(),
-            row["content"].as<std::string>(),
-            std::to_string(id));  // Use author_id instead of owner
-        doc->setId(row["id"].as<int>());
-        doc->setAuthorId(id);
-        doc->setPublic(row["is_public"].as<bool>());
-        // Set other document properties as needed
-        documents.push_back(doc);
+        Author *author = byId[row["author_id"].as<int>()];
+        if (author->documents.size() == DOCUMENTS_PAGE_SIZE)
+        {
+            author->documentsCursor = std::to_string(author->documents.back()->getId());
+            continue;
+        }
+        author->documents.push_back(std::make_shared<Document>(Document::fromMetadataRow(row)));
     }
-    txn.commit();
-}
\ No newline at end of file
+}
@@ -1,15 +1,36 @@
 #include <models/document.hpp>
+#include <models/document_history.hpp>
 #include <utils/logger.hpp>
 #include <db/db_manager.hpp>
+#include <db/async_database.hpp>
+#include <db/prepared_statements.hpp>
+#include <services/search_index.hpp>
+#include <services/document_cache.hpp>
 #include <sstream>
 #include <pqxx/pqxx>
 #include <utils/SQLBuilder.hpp>
 #include <iostream>
 #include <iomanip>
+#include <optional>
 #include <utils/timestampConverter.hpp>
 
-Document::Document(const std::string &title, const std::string &content, const std::string &owner)
-    : title(title), content(content), is_public(false), author_id(-1)
+namespace
+{
+    // A conditional write matched no row: either the document is gone or it
+    // has moved past the expected version
+    [[noreturn]] void throwUpdateConflict(ConnectionLease &conn, pqxx::transaction_base &txn, int id)
+    {
+        auto current = txn.exec_prepared(conn.prepare(PreparedStatements::DOCUMENT_CURRENT_VERSION), id);
+        if (current.empty())
+        {
+            throw std::runtime_error("Document not found");
+        }
+        throw VersionConflict(current[0]["version"].as<int>());
+    }
+}
+
+Document::Document(const std::string &title, std::string_view content, const std::string &owner)
+    : title(title), content(content), savedContent(this->content), is_public(false), author_id(-1), version(1)
 {
     time(&created_at);
     updated_at = created_at;
@@ -22,9 +43,57 @@ void Document::setTitle(const std::string &newTitle)
     updateTimestamp();
 }
 
-void Document::setContent(const std::string &newContent)
+void Document::setContent(std::string_view newContent)
 {
-    content = newContent;
+    content = Rope(newContent);
+    flatContent.reset();
+    updateTimestamp();
+}
+
+const std::string &Document::getContent() const
+{
+    if (!flatContent)
+    {
+        flatContent = std::make_shared<const std::string>(content.str());
+    }
+    return *flatContent;
+}
+
+void Document::insertText(std::size_t position, const std::string &text)
+{
+    content.insert(position, text);
+    flatContent.reset();
+    updateTimestamp();
+}
+
+void Document::eraseText(std::size_t position, std::size_t length)
+{
+    content.erase(position, length);
+    flatContent.reset();
+    updateTimestamp();
+}
+
+void Document::applyEdits(const std::vector<TextOperation> &operations)
+{
+    // Edit a snapshot so a failing operation leaves the content as it was
+    Rope edited = content;
+    for (const auto &operation : operations)
+    {
+        if (operation.position < 0 || (operation.type == TextOperation::Type::Delete && operation.length < 0))
+        {
+            throw std::out_of_range("Negative operation position or length");
+        }
+        if (operation.type == TextOperation::Type::Insert)
+        {
+            edited.insert(operation.position, operation.text);
+        }
+        else
+        {
+            edited.erase(operation.position, operation.length);
+        }
+    }
+    content = std::move(edited);
+    flatContent.reset();
     updateTimestamp();
 }
 
@@ -50,26 +119,15 @@ bool Document::save()
     try
     {
         auto conn = DatabaseManager::getInstance().getConnection();
-        pqxx::work txn(*conn);
-        SQLBuilder builder;
         if (id == -1)
         {
-            std::vector<std::string> columns = {
-                "title", "content", "created_at", "updated_at", "is_public", "author_id"};
-            std::vector<std::string> values = {
-                title, content,
-                "to_timestamp(" + std::to_string(created_at) + ")",
-                "to_timestamp(" + std::to_string(updated_at) + ")",
-                is_public ? "true" : "false",
-                std::to_string(author_id)};
-
-            std::string sql = builder
-                                  .insert("documents", columns, values)
-                                  .returning({"id", "author_id"})
-                                  .build();
-
-            Logger::debug({"Executing SQL: " + sql});
-            auto result = txn.exec(sql);
+            auto statement = conn.prepare(PreparedStatements::DOCUMENT_INSERT);
+            pqxx::work txn(*conn);
+            auto result = txn.exec_prepared(statement,
+                                            title, getContent(),
+                                            static_cast<long long>(created_at),
+                                            static_cast<long long>(updated_at),
+                                            is_public, author_id);
 
             if (result.empty() || result[0].empty())
             {
@@ -77,26 +135,44 @@ bool Document::save()
             }
 
             id = result[0][0].as<int>();
+            version = result[0]["version"].as<int>(1);
+            DocumentHistory::record(conn, txn, id, version, nullptr);
+            txn.commit();
         }
         else
         {
-            std::vector<std::pair<std::string, std::string>> updates = {
-                {"title", title}, {"content", content}, {"is_public", is_public ? "true" : "false"}, {"author_id", std::to_string(author_id)}};
-
-            std::string updateSql = builder
-                                        .update("documents")
-                                        .set(updates)
-                                        .where({{"id", std::to_string(id), "="}})
-                                        .returning({"id", "author_id"})
-                                        .build();
+            auto statement = conn.prepare(PreparedStatements::DOCUMENT_UPDATE);
+            pqxx::work txn(*conn);
+            auto result = txn.exec_prepared(statement, id, title, getContent(), is_public,
+                                            std::optional<int>(author_id), std::optional<int>(version));
+            if (result.empty())
+            {
+                throwUpdateConflict(conn, txn, id);
+            }
 
-            txn.exec(updateSql);
+            // The row was still at version, whose content this object was
+            // loaded with, so the history delta is a plain diff
+            int updatedVersion = result[0]["version"].as<int>(version);
+            if (updatedVersion != version)
+            {
+                auto operations = DocumentHistory::diff(savedContent.str(), getContent());
+                DocumentHistory::record(conn, txn, id, updatedVersion, &operations);
+                version = updatedVersion;
+                updated_at = convertTimestampToTimeT(result[0]["updated_at"].as<std::string>());
+            }
+            txn.commit();
         }
+        savedContent = content;
 
-        txn.commit();
+        DocumentCache::getInstance().put(*this);
+        SearchIndex::getInstance().index(*this);
         Logger::info({"Document saved successfully with ID: " + std::to_string(id)});
         return true;
     }
+    catch (const VersionConflict &)
+    {
+        throw;
+    }
     catch (const std::exception &e)
     {
         Logger::error({"Failed to save document: " + std::string(e.what())});
@@ -108,12 +184,7 @@ bool Document::remove()
 {
     try
     {
-        auto conn = DatabaseManager::getInstance().getConnection();
-        pqxx::work txn(*conn);
-
-        SQLBuilder builder;
-
-        std::string sql = builder.deleteFrom("documents").where({{"id", std::to_string(id), "="}}).build();
+        return removeById(id, std::nullopt);
     }
     catch (const std::exception &e)
     {
@@ -122,39 +193,146 @@ bool Document::remove()
     }
 }
 
-std::vector<Document> Document::search(
-    const std::string &query, int author_id, bool includePrivate)
+bool Document::removeById(int id, std::optional<int> expectedVersion)
 {
-    try
+    auto conn = DatabaseManager::getInstance().getConnection();
+    auto statement = conn.prepare(PreparedStatements::DOCUMENT_DELETE);
+    pqxx::work txn(*conn);
+    auto result = txn.exec_prepared(statement, id, expectedVersion);
+    if (result.empty())
+    {
+        if (!expectedVersion)
+        {
+            return false;
+        }
+        throwUpdateConflict(conn, txn, id);
+    }
+    txn.commit();
+
+    DocumentCache::getInstance().invalidate(id);
+    SearchIndex::getInstance().remove(id);
+    Logger::info({"Document removed successfully with ID: " + std::to_string(id)});
+    return true;
+}
+
+Document Document::update(int id, const DocumentChanges &changes, std::optional<int> expectedVersion)
+{
+    // A cached copy is the content of its version; if the update lands right
+    // on top of it the history gets a diff and the cache is moved forward
+    // instead of dropped
+    auto &cache = DocumentCache::getInstance();
+    uint64_t generation = cache.generation(id);
+    std::shared_ptr<Document> base = cache.get(id);
+
+    // The lease ends with the transaction so that the re-read below does not
+    // hold a second pooled connection
+    std::optional<Document> doc;
+    bool onBase = false;
     {
         auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::DOCUMENT_UPDATE);
         pqxx::work txn(*conn);
-        SQLBuilder builder;
-        auto query_builder = builder.select({"*"}).from("documents").where({{"title", query, "LIKE"}});
-        if (author_id != -1)
+        auto result = txn.exec_prepared(statement, id, changes.title, changes.content, changes.isPublic,
+                                        std::optional<int>(), expectedVersion);
+        if (result.empty())
+        {
+            throwUpdateConflict(conn, txn, id);
+        }
+
+        doc = fromMetadataRow(result[0]);
+        onBase = base && doc->version == base->version + 1;
+        if (changes.content)
+        {
+            if (onBase)
+            {
+                auto operations = DocumentHistory::diff(base->getContent(), *changes.content);
+                DocumentHistory::record(conn, txn, id, doc->version, &operations);
+            }
+            else
+            {
+                DocumentHistory::record(conn, txn, id, doc->version, nullptr);
+            }
+        }
+        txn.commit();
+    }
+
+    std::shared_ptr<Document> updated;
+    if (base && (onBase || doc->version == base->version))
+    {
+        updated = base;
+        updated->title = doc->title;
+        updated->is_public = doc->is_public;
+        if (changes.content)
+        {
+            updated->setContent(*changes.content);
+        }
+        updated->savedContent = updated->content;
+        updated->version = doc->version;
+        updated->updated_at = doc->updated_at;
+        cache.replace(*updated, generation);
+    }
+    else
+    {
+        cache.invalidate(id);
+    }
+
+    auto &index = SearchIndex::getInstance();
+    if (index.isReady())
+    {
+        if (!updated)
         {
-            query_builder.where({{"author_id", std::to_string(author_id), "="}});
+            updated = findById(id);
         }
-        if (!includePrivate)
+        if (updated)
+        {
+            index.index(*updated);
+        }
+    }
+
+    Logger::info({"Document updated with ID: " + std::to_string(id) + " (version " + std::to_string(doc->version) + ")"});
+    return *doc;
+}
+
+DocumentPage Document::search(
+    const std::string &query, int author_id, bool includePrivate, int limit, const std::string &cursor)
+{
+    // The cursor is the (rank, id) of the last row of the previous page. A
+    // malformed cursor is the caller's mistake, so let it propagate.
+    std::optional<std::string> cursorRank;
+    std::optional<int> cursorId;
+    if (!cursor.empty())
+    {
+        size_t separator = cursor.rfind('_');
+        if (separator == std::string::npos || separator == 0)
         {
-            query_builder.where({{"is_public", "true", "="}});
+            throw std::invalid_argument("Invalid search cursor");
         }
-        std::string sql = query_builder.build();
-        auto result = txn.exec(sql);
+        cursorRank = cursor.substr(0, separator);
+        cursorId = std::stoi(cursor.substr(separator + 1));
+        std::stof(*cursorRank);
+    }
+
+    try
+    {
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::DOCUMENT_SEARCH);
+        pqxx::work txn(*conn);
+        auto result = txn.exec_prepared(statement, query, author_id, includePrivate, cursorRank, cursorId, limit);
 
-        std::vector<Document> documents;
+        DocumentPage page;
         for (auto row : result)
         {
-            Document doc(row["title"].as<std::string>(), row["content"].as<std::string>(), row["author_id"].as<std::string>());
-            doc.setId(row["id"].as<int>());
-            doc.created_at = convertTimestampToTimeT(row["created_at"].as<std::string>());
-            doc.updated_at = convertTimestampToTimeT(row["updated_at"].as<std::string>());
-            doc.is_public = row["is_public"].as<bool>();
-            documents.push_back(doc);
+            Document doc = fromMetadataRow(row);
+            page.documents.push_back(doc);
+
+            if (static_cast<int>(page.documents.size()) == limit)
+            {
+                page.nextCursor = row["rank"].as<std::string>() + "_" + std::to_string(doc.getId());
+            }
         }
 
         txn.commit();
-        return documents;
+        return page;
     }
     catch (const std::exception &e)
     {
@@ -163,16 +341,193 @@ std::vector<Document> Document::search(
     }
 }
 
-std::shared_ptr<Document> Document::findById(int id)
+DocumentPage Document::findByAuthor(int author_id, bool includePrivate, int limit, const std::string &cursor)
 {
+    // The cursor is the id of the last document of the previous page
+    std::optional<int> cursorId;
+    if (!cursor.empty())
+    {
+        cursorId = std::stoi(cursor);
+    }
+
     try
     {
         auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::DOCUMENTS_PAGE_BY_AUTHOR);
         pqxx::work txn(*conn);
+        auto result = txn.exec_prepared(statement, author_id, cursorId, limit, includePrivate);
+        txn.commit();
+
+        DocumentPage page;
+        for (auto row : result)
+        {
+            page.documents.push_back(fromMetadataRow(row));
+        }
+        if (static_cast<int>(page.documents.size()) == limit)
+        {
+            page.nextCursor = std::to_string(page.documents.back().getId());
+        }
+        return page;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to list documents of author: " + std::string(e.what())});
+        return {};
+    }
+}
+
+Document Document::fromMetadataRow(const pqxx::row &row)
+{
+    Document doc(row["title"].as<std::string>(), "", "");
+    doc.id = row["id"].as<int>();
+    doc.author_id = row["author_id"].as<int>(-1);
+    doc.created_at = convertTimestampToTimeT(row["created_at"].as<std::string>());
+    doc.updated_at = convertTimestampToTimeT(row["updated_at"].as<std::string>());
+    doc.is_public = row["is_public"].as<bool>();
+    doc.version = row["version"].as<int>(1);
+    return doc;
+}
+
+Document Document::applyOperations(int id, int baseVersion, const std::vector<TextOperation> &operations)
+{
+    if (operations.empty() || operations.size() > MAX_OPERATIONS)
+    {
+        throw std::invalid_argument("Expected between 1 and " + std::to_string(MAX_OPERATIONS) + " operations");
+    }
+
+    // The lease ends with the transaction so that the re-read below does not
+    // hold a second pooled connection
+    std::optional<Document> doc;
+    {
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto lockStatement = conn.prepare(PreparedStatements::DOCUMENT_LOCK_FOR_EDIT);
+        pqxx::work txn(*conn);
+
+        // Lock the row so the version and length checked here are the ones
+        // the update applies to
+        auto current = txn.exec_prepared(lockStatement, id);
+        if (current.empty())
+        {
+            throw std::runtime_error("Document not found");
+        }
+        int currentVersion = current[0]["version"].as<int>();
+        if (currentVersion != baseVersion)
+        {
+            throw VersionConflict(currentVersion);
+        }
+
+        // Validate every operation against the length it will see and track
+        // the span [first, last) of the edited text that differs from the
+        // stored one: nothing before first is touched, and everything from
+        // last on is the stored text's unchanged tail.
+        const long long storedLength = current[0]["length"].as<long long>();
+        long long length = storedLength;
+        long long first = length;
+        long long last = 0;
+        for (const auto &operation : operations)
+        {
+            if (operation.position < 0 || operation.position > length)
+            {
+                throw std::out_of_range("Operation position " + std::to_string(operation.position) + " is outside the document");
+            }
+
+            first = std::min(first, operation.position);
+            if (operation.type == TextOperation::Type::Insert)
+            {
+                long long inserted = static_cast<long long>(Rope::utf8Length(operation.text));
+                last = std::max(last, operation.position) + inserted;
+                length += inserted;
+            }
+            else
+            {
+                if (operation.length < 0 || operation.position + operation.length > length)
+                {
+                    throw std::out_of_range("Delete of " + std::to_string(operation.length) + " characters at " +
+                                            std::to_string(operation.position) + " runs past the end of the document");
+                }
+                last = std::max(last, operation.position + operation.length) - operation.length;
+                length -= operation.length;
+            }
+        }
+        last = std::max(last, first);
+
+        // Only the stored characters the span replaces travel either way, and
+        // Postgres rewrites the content once instead of once per operation
+        long long storedSpan = storedLength - (length - last) - first;
+        auto spanStatement = conn.prepare(PreparedStatements::DOCUMENT_CONTENT_SPAN);
+        auto span = txn.exec_prepared(spanStatement, id, first + 1, storedSpan);
+        Rope edited(span[0]["span"].as<std::string>());
+        for (const auto &operation : operations)
+        {
+            if (operation.type == TextOperation::Type::Insert)
+            {
+                edited.insert(operation.position - first, operation.text);
+            }
+            else
+            {
+                edited.erase(operation.position - first, operation.length);
+            }
+        }
 
-        SQLBuilder builder;
-        std::string sql = builder.select({"*"}).from("documents").where({{"id", std::to_string(id), "="}}).build();
-        auto result = txn.exec(sql);
+        auto replaceStatement = conn.prepare(PreparedStatements::DOCUMENT_REPLACE_SPAN);
+        auto result = txn.exec_prepared(replaceStatement, id, edited.str(), first + 1, storedSpan);
+        doc = fromMetadataRow(result[0]);
+        DocumentHistory::record(conn, txn, id, doc->version, &operations);
+        txn.commit();
+    }
+
+    // A hot document still cached at the base version is brought forward in
+    // memory; the rope makes that O(log n) per operation. Otherwise drop it.
+    auto &cache = DocumentCache::getInstance();
+    uint64_t generation = cache.generation(id);
+    std::shared_ptr<Document> updated = cache.get(id);
+    if (updated && updated->version == baseVersion)
+    {
+        updated->applyEdits(operations);
+        updated->savedContent = updated->content;
+        updated->version = doc->version;
+        updated->updated_at = doc->updated_at;
+        cache.replace(*updated, generation);
+    }
+    else
+    {
+        cache.invalidate(id);
+        updated = nullptr;
+    }
+
+    auto &index = SearchIndex::getInstance();
+    if (index.isReady())
+    {
+        if (!updated)
+        {
+            updated = findById(id);
+        }
+        if (updated)
+        {
+            index.index(*updated);
+        }
+    }
+
+    Logger::info({"Applied " + std::to_string(operations.size()) + " operations to document " + std::to_string(id) +
+                  " (version " + std::to_string(doc->version) + ")"});
+    return *doc;
+}
+
+std::shared_ptr<Document> Document::findById(int id)
+{
+    auto &cache = DocumentCache::getInstance();
+    if (auto cached = cache.get(id))
+    {
+        return cached;
+    }
+    uint64_t generation = cache.generation(id);
+
+    try
+    {
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::DOCUMENT_FIND_BY_ID);
+        pqxx::work txn(*conn);
+        auto result = txn.exec_prepared(statement, id);
         txn.commit();
 
         if (result.empty())
@@ -187,7 +542,10 @@ std::shared_ptr<Document> Document::findById(int id)
         doc->created_at = convertTimestampToTimeT(row["created_at"].as<std::string>());
         doc->updated_at = convertTimestampToTimeT(row["updated_at"].as<std::string>());
         doc->is_public = row["is_public"].as<bool>();
+        doc->author_id = row["author_id"].as<int>(-1);
+        doc->version = row["version"].as<int>(1);
 
+        cache.fill(*doc, generation);
         return doc;
     }
     catch (const std::exception &e)
@@ -196,3 +554,90 @@ std::shared_ptr<Document> Document::findById(int id)
         return nullptr;
     }
 }
+
+void Document::findByIdAsync(int id, std::function<void(std::exception_ptr, std::shared_ptr<Document>)> callback)
+{
+    auto &cache = DocumentCache::getInstance();
+    if (auto cached = cache.get(id))
+    {
+        callback(nullptr, cached);
+        return;
+    }
+    uint64_t generation = cache.generation(id);
+
+    AsyncDatabase::getInstance().query(
+        "SELECT * FROM documents WHERE id = $1;",
+        {std::to_string(id)},
+        [id, generation, callback](std::exception_ptr error, AsyncQueryResult result)
+        {
+            std::shared_ptr<Document> doc;
+            try
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+                if (result.empty())
+                {
+                    Logger::warn({"Document not found with ID: " + std::to_string(id)});
+                }
+                else
+                {
+                    doc = std::make_shared<Document>(result.getString(0, "title"), result.getString(0, "content"), result.getString(0, "owner"));
+                    doc->setId(result.getInt(0, "id"));
+                    doc->created_at = convertTimestampToTimeT(result.getString(0, "created_at"));
+                    doc->updated_at = convertTimestampToTimeT(result.getString(0, "updated_at"));
+                    doc->is_public = result.getBool(0, "is_public");
+                    if (!result.isNull(0, "author_id"))
+                    {
+                        doc->author_id = result.getInt(0, "author_id");
+                    }
+                    doc->version = result.getInt(0, "version");
+                    DocumentCache::getInstance().fill(*doc, generation);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                Logger::error({"Failed to find document: " + std::string(e.what())});
+                error = std::current_exception();
+                doc.reset();
+            }
+            callback(error, doc);
+        });
+}
+
+void Document::findValidatorAsync(int id, std::function<void(std::exception_ptr, std::optional<DocumentValidator>)> callback)
+{
+    if (auto cached = DocumentCache::getInstance().get(id))
+    {
+        callback(nullptr, DocumentValidator{cached->version, cached->updated_at});
+        return;
+    }
+
+    AsyncDatabase::getInstance().query(
+        "SELECT version, updated_at FROM documents WHERE id = $1;",
+        {std::to_string(id)},
+        [id, callback](std::exception_ptr error, AsyncQueryResult result)
+        {
+            std::optional<DocumentValidator> validator;
+            try
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+                if (!result.empty())
+                {
+                    validator = DocumentValidator{result.getInt(0, "version"),
+                                                  convertTimestampToTimeT(result.getString(0, "updated_at"))};
+                }
+            }
+            catch (const std::exception &e)
+            {
+                Logger::error({"Failed to look up version of document " + std::to_string(id) + ": " + std::string(e.what())});
+                error = std::current_exception();
+                validator.reset();
+            }
+            callback(error, validator);
+        });
+}
@@ -0,0 +1,267 @@
+#include <models/document_history.hpp>
+#include <config/app_config.hpp>
+#include <db/db_manager.hpp>
+#include <db/prepared_statements.hpp>
+#include <utils/logger.hpp>
+#include <utils/rope.hpp>
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace
+{
+    // Delta layout: varint operation count, then per operation a tag byte,
+    // the varint position and either varint length + UTF-8 text (insert) or
+    // the varint length (delete). Positions and lengths count characters.
+    constexpr uint8_t INSERT_TAG = 0;
+    constexpr uint8_t DELETE_TAG = 1;
+
+    void appendVarint(std::string &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    uint64_t readVarint(std::string_view &in)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (in.empty())
+            {
+                throw std::runtime_error("Truncated document delta");
+            }
+            auto byte = static_cast<uint8_t>(in.front());
+            in.remove_prefix(1);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        throw std::runtime_error("Malformed varint in document delta");
+    }
+
+    bool isContinuationByte(char c)
+    {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    void applyDelta(Rope &content, const std::vector<TextOperation> &operations)
+    {
+        for (const auto &operation : operations)
+        {
+            if (operation.type == TextOperation::Type::Insert)
+            {
+                content.insert(operation.position, operation.text);
+            }
+            else
+            {
+                content.erase(operation.position, operation.length);
+            }
+        }
+    }
+}
+
+void DocumentHistory::record(ConnectionLease &conn, pqxx::transaction_base &txn, int documentId, int version,
+                             const std::vector<TextOperation> *operations)
+{
+    int interval = std::max(1, AppConfig::getInstance().getDocumentSnapshotInterval());
+    if (!operations || (version - 1) % interval == 0)
+    {
+        txn.exec_prepared(conn.prepare(PreparedStatements::DOCUMENT_VERSION_SNAPSHOT), documentId);
+        return;
+    }
+
+    std::string delta = encodeDelta(*operations);
+    std::basic_string_view<std::byte> bytes(reinterpret_cast<const std::byte *>(delta.data()), delta.size());
+    txn.exec_prepared(conn.prepare(PreparedStatements::DOCUMENT_VERSION_DELTA), documentId, version, bytes);
+}
+
+DocumentVersionPage DocumentHistory::list(int documentId, int limit, int before)
+{
+    std::optional<int> beforeVersion;
+    if (before > 0)
+    {
+        beforeVersion = before;
+    }
+
+    try
+    {
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::DOCUMENT_VERSIONS_PAGE);
+        pqxx::work txn(*conn);
+        auto result = txn.exec_prepared(statement, documentId, beforeVersion, limit);
+        txn.commit();
+
+        DocumentVersionPage page;
+        for (auto row : result)
+        {
+            DocumentVersion version;
+            version.version = row["version"].as<int>();
+            version.created_at = static_cast<time_t>(row["created_at"].as<long long>());
+            version.isSnapshot = row["is_snapshot"].as<bool>();
+            version.storedBytes = row["bytes"].as<std::size_t>(0);
+            page.versions.push_back(std::move(version));
+        }
+        if (static_cast<int>(page.versions.size()) == limit)
+        {
+            page.nextBefore = page.versions.back().version;
+        }
+        return page;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to list document versions: " + std::string(e.what())});
+        return {};
+    }
+}
+
+std::optional<DocumentVersion> DocumentHistory::find(int documentId, int version)
+{
+    try
+    {
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::DOCUMENT_VERSION_CHAIN);
+        pqxx::work txn(*conn);
+        auto result = txn.exec_prepared(statement, documentId, version);
+        txn.commit();
+
+        // The chain must start at a snapshot and have no gaps up to version
+        if (result.empty() || result[0]["snapshot"].is_null() ||
+            result[result.size() - 1]["version"].as<int>() != version ||
+            result[result.size() - 1]["version"].as<int>() - result[0]["version"].as<int>() + 1 != static_cast<int>(result.size()))
+        {
+            return std::nullopt;
+        }
+
+        DocumentVersion found;
+        found.version = version;
+        found.created_at = static_cast<time_t>(result[result.size() - 1]["created_at"].as<long long>());
+        found.isSnapshot = result.size() == 1;
+
+        Rope content(result[0]["snapshot"].as<std::string>());
+        found.storedBytes = content.byteSize();
+        for (std::size_t i = 1; i < result.size(); i++)
+        {
+            auto delta = result[i]["delta"].as<std::basic_string<std::byte>>();
+            applyDelta(content, decodeDelta(std::string_view(reinterpret_cast<const char *>(delta.data()), delta.size())));
+            found.storedBytes = delta.size();
+        }
+        found.content = content.str();
+        return found;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to load version " + std::to_string(version) + " of document " +
+                       std::to_string(documentId) + ": " + std::string(e.what())});
+        return std::nullopt;
+    }
+}
+
+std::vector<TextOperation> DocumentHistory::diff(std::string_view before, std::string_view after)
+{
+    std::size_t limit = std::min(before.size(), after.size());
+    std::size_t prefix = 0;
+    while (prefix < limit && before[prefix] == after[prefix])
+    {
+        prefix++;
+    }
+    // Never split a character: back up to a boundary in both texts
+    while (prefix > 0 && ((prefix < before.size() && isContinuationByte(before[prefix])) ||
+                          (prefix < after.size() && isContinuationByte(after[prefix]))))
+    {
+        prefix--;
+    }
+
+    std::size_t suffix = 0;
+    while (suffix < limit - prefix && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix])
+    {
+        suffix++;
+    }
+    while (suffix > 0 && isContinuationByte(before[before.size() - suffix]))
+    {
+        suffix--;
+    }
+
+    std::vector<TextOperation> operations;
+    long long position = static_cast<long long>(Rope::utf8Length(before.substr(0, prefix)));
+    auto removed = before.substr(prefix, before.size() - prefix - suffix);
+    auto inserted = after.substr(prefix, after.size() - prefix - suffix);
+    if (!removed.empty())
+    {
+        operations.push_back(TextOperation{TextOperation::Type::Delete, position, "",
+                                           static_cast<long long>(Rope::utf8Length(removed))});
+    }
+    if (!inserted.empty())
+    {
+        operations.push_back(TextOperation{TextOperation::Type::Insert, position, std::string(inserted), 0});
+    }
+    return operations;
+}
+
+std::string DocumentHistory::encodeDelta(const std::vector<TextOperation> &operations)
+{
+    std::string delta;
+    appendVarint(delta, operations.size());
+    for (const auto &operation : operations)
+    {
+        bool insert = operation.type == TextOperation::Type::Insert;
+        delta.push_back(static_cast<char>(insert ? INSERT_TAG : DELETE_TAG));
+        appendVarint(delta, static_cast<uint64_t>(operation.position));
+        if (insert)
+        {
+            appendVarint(delta, operation.text.size());
+            delta += operation.text;
+        }
+        else
+        {
+            appendVarint(delta, static_cast<uint64_t>(operation.length));
+        }
+    }
+    return delta;
+}
+
+std::vector<TextOperation> DocumentHistory::decodeDelta(std::string_view delta)
+{
+    uint64_t count = readVarint(delta);
+    std::vector<TextOperation> operations;
+    operations.reserve(std::min<uint64_t>(count, delta.size()));
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (delta.empty())
+        {
+            throw std::runtime_error("Truncated document delta");
+        }
+        auto tag = static_cast<uint8_t>(delta.front());
+        delta.remove_prefix(1);
+
+        TextOperation operation{TextOperation::Type::Insert, static_cast<long long>(readVarint(delta)), "", 0};
+        if (tag == INSERT_TAG)
+        {
+            uint64_t size = readVarint(delta);
+            if (size > delta.size())
+            {
+                throw std::runtime_error("Truncated document delta");
+            }
+            operation.text = std::string(delta.substr(0, size));
+            delta.remove_prefix(size);
+        }
+        else if (tag == DELETE_TAG)
+        {
+            operation.type = TextOperation::Type::Delete;
+            operation.length = static_cast<long long>(readVarint(delta));
+        }
+        else
+        {
+            throw std::runtime_error("Unknown operation in document delta");
+        }
+        operations.push_back(std::move(operation));
+    }
+    return operations;
+}
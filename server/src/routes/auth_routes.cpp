@@ -6,6 +6,9 @@
 #include <config/app_config.hpp>
 #include <utils/logger.hpp>
 #include <server/route_manager.hpp>
+#include <server/conditional_request.hpp>
+#include <server/response_encoder.hpp>
+#include <server/request_body.hpp>
 
 namespace http = boost::beast::http;
 using request = http::request<http::string_body>;
@@ -19,8 +22,8 @@ void AuthRoutes::handleRegisterUser(const request &req, response &res)
     try
     {
         Logger::debug({"Registering user"});
-        json data = json::parse(req.body());
-        json result = authController.registerUser(data);
+        auto data = RequestBody::parseRegistration(req.body());
+        json result = authController.registerUser(std::string(data.name), std::string(data.email), std::string(data.password));
 
         if (result.find("error") != result.end())
         {
@@ -31,14 +34,13 @@ void AuthRoutes::handleRegisterUser(const request &req, response &res)
 
         res.result(http::status::created);
         res.set(http::field::set_cookie, "token=" + token + "; Max-Age=3600; HttpOnly; Secure; SameSite=Strict; Path=/");
-        res.set(http::field::content_type, "application/json");
-        res.body() = json{{"message", "User registered successfully"}}.dump();
+        ResponseEncoders::write(req, res, json{{"message", "User registered successfully"}});
     }
     catch (const std::exception &e)
     {
         Logger::error({"Error in handleRegisterUser: " + std::string(e.what())});
         res.result(http::status::bad_request);
-        res.body() = json{{"error", e.what()}}.dump();
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
     }
 }
 
@@ -47,8 +49,8 @@ void AuthRoutes::handleLoginUser(const request &req, response &res)
     try
     {
         Logger::debug({"Logging in user"});
-        json data = json::parse(req.body());
-        json result = authController.loginUser(data);
+        auto data = RequestBody::parseLogin(req.body());
+        json result = authController.loginUser(std::string(data.email), std::string(data.password));
         if (result.find("error") != result.end())
         {
             throw std::runtime_error(result.dump());
@@ -57,14 +59,13 @@ void AuthRoutes::handleLoginUser(const request &req, response &res)
 
         res.result(http::status::ok);
         res.set(http::field::set_cookie, "token=" + token + "; Max-Age=3600; HttpOnly; Secure; SameSite=Strict; Path=/");
-        res.set(http::field::content_type, "application/json");
-        res.body() = result.dump();
+        ResponseEncoders::write(req, res, result);
     }
     catch (std::exception &e)
     {
         Logger::error({"error in logging in", e.what()});
         res.result(http::status::bad_request);
-        res.body() = json{{"error", e.what()}}.dump();
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
     }
 }
 
@@ -75,14 +76,13 @@ void AuthRoutes::handleLogoutUser(const request &req, response &res)
         Logger::debug({"Logging out user"});
         res.result(http::status::ok);
         res.set(http::field::set_cookie, "token=; Max-Age=0; HttpOnly; Secure; SameSite=Strict; Path=/");
-        res.set(http::field::content_type, "application/json");
-        res.body() = json{{"message", "User logged out successfully"}}.dump();
+        ResponseEncoders::write(req, res, json{{"message", "User logged out successfully"}});
     }
     catch (std::exception &e)
     {
         Logger::debug({"error in logging out", e.what()});
         res.result(http::status::bad_request);
-        res.body() = json{{"error", e.what()}}.dump();
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
     }
 }
 
@@ -91,21 +91,37 @@ void AuthRoutes::handleMe(const request &req, response &res)
     try
     {
         Logger::debug({"Getting user data"});
-        std::string token = req.at(http::field::cookie);
+        std::string token(req.at(http::field::cookie));
         token = token.substr(token.find("token=") + 6);
+
+        const auto &encoder = ResponseEncoders::getInstance().negotiate(req);
+        // Taken before the profile is loaded, so a concurrent change can only
+        // make the tag older than the body, never newer
+        auto fingerprint = authController.meFingerprint(token);
+        std::string etag = fingerprint ? ConditionalRequest::etag(*fingerprint, encoder.tagSuffix()) : std::string();
+        if (fingerprint && ConditionalRequest::notModified(req, etag, std::nullopt))
+        {
+            res.set(http::field::vary, "Accept");
+            ConditionalRequest::setNotModified(res, etag, std::nullopt);
+            return;
+        }
+
         json result = authController.me(token);
         if (result.find("error") != result.end())
         {
             throw std::runtime_error(result.dump());
         }
         res.result(http::status::ok);
-        res.set(http::field::content_type, "application/json");
-        res.body() = result.dump();
+        if (fingerprint)
+        {
+            res.set(http::field::etag, etag);
+        }
+        ResponseEncoders::write(encoder, res, result);
     }
     catch (std::exception &e)
     {
         res.result(http::status::bad_request);
-        res.body() = json{{"error", e.what()}}.dump();
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
     }
 }
 
@@ -2,32 +2,190 @@
 #include <utils/logger.hpp>
 #include <nlohmann/json.hpp>
 #include <server/route_manager.hpp>
+#include <server/query_string.hpp>
+#include <server/conditional_request.hpp>
+#include <server/request_body.hpp>
+#include <server/response_encoder.hpp>
+#include <config/app_config.hpp>
+#include <utils/json_writer.hpp>
+#include <utils/jwtManger.hpp>
+#include <algorithm>
 
 using json = nlohmann::json;
 
 DocumentController DocumentRoutes::documentController;
 
+int DocumentRoutes::documentId(const http::request<http::string_body> &req, const RouteParams &params)
+{
+    if (params.contains("id"))
+    {
+        return std::stoi(std::string(params.get("id")));
+    }
+    QueryString query(std::string_view(req.target().data(), req.target().size()));
+    return query.get<int>("id");
+}
+
+std::optional<int> DocumentRoutes::requestAuthorId(const http::request<http::string_body> &req)
+{
+    auto cookie = req.find(http::field::cookie);
+    if (cookie == req.end())
+    {
+        return std::nullopt;
+    }
+    std::string_view header(cookie->value().data(), cookie->value().size());
+    auto start = header.find("token=");
+    if (start == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+    start += 6;
+    std::string token(header.substr(start, header.find(';', start) - start));
+
+    try
+    {
+        json payload = JWTManager::getInstance().verifySignatureAndDecode(token, AppConfig::getInstance().getSecretKey());
+        if (payload.is_object() && payload.contains("id") && payload["id"].is_number_integer())
+        {
+            return payload["id"].get<int>();
+        }
+    }
+    catch (const std::exception &e)
+    {
+        Logger::debug({"Ignoring unreadable token: " + std::string(e.what())});
+    }
+    return std::nullopt;
+}
+
+void DocumentRoutes::setEtag(http::response<http::string_body> &res, const json &document, const ResponseEncoder &encoder)
+{
+    if (document.contains("id") && document.contains("version"))
+    {
+        res.set(http::field::etag, ConditionalRequest::etag(document["id"].get<int>(), document["version"].get<int>(), encoder.tagSuffix()));
+    }
+}
+
 void DocumentRoutes::handleGetDocument(
     const http::request<http::string_body> &req,
-    http::response<http::string_body> &res)
+    http::response<http::string_body> &res,
+    const RouteParams &params,
+    AsyncDone done)
 {
     try
     {
-        Logger::debug({"Getting document with ID: ", req.target()});
-        // int id = std::stoi(req.target().to_string());
-        int id = 1;
-        auto document = documentController.getDocument(id);
+        Logger::debug({"Getting document: " + std::string(req.target())});
+        int id = documentId(req, params);
 
-        res.result(http::status::ok);
-        res.set(http::field::content_type, "application/json");
-        res.body() = document;
+        const ResponseEncoder &encoder = ResponseEncoders::getInstance().negotiate(req);
+
+        if (!ConditionalRequest::isConditional(req))
+        {
+            sendDocument(id, encoder, res, std::move(done));
+            return;
+        }
+
+        // Polling clients usually already hold the current version: compare
+        // validators first and only load the content when it changed
+        documentController.getDocumentValidatorAsync(id, [&req, &res, &encoder, id, done](std::exception_ptr error, std::optional<DocumentValidator> validator)
+                                                     {
+                                                         if (error)
+                                                         {
+                                                             sendLoadFailure(encoder, res, done);
+                                                             return;
+                                                         }
+                                                         if (validator)
+                                                         {
+                                                             auto etag = ConditionalRequest::etag(id, validator->version, encoder.tagSuffix());
+                                                             if (ConditionalRequest::notModified(req, etag, validator->updated_at))
+                                                             {
+                                                                 res.set(http::field::vary, "Accept");
+                                                                 ConditionalRequest::setNotModified(res, etag, validator->updated_at);
+                                                                 done(nullptr);
+                                                                 return;
+                                                             }
+                                                         }
+                                                         sendDocument(id, encoder, res, done); });
     }
     catch (const std::exception &e)
     {
-        res.result(http::status::internal_server_error);
-        res.body() = json{{"error", e.what()}}.dump();
+        res.result(http::status::bad_request);
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
+        res.prepare_payload();
+        done(nullptr);
     }
+}
+
+void DocumentRoutes::sendDocument(int id, const ResponseEncoder &encoder, http::response<http::string_body> &res, AsyncDone done)
+{
+    documentController.getDocumentAsync(id, [&res, &encoder, done](std::exception_ptr error, std::shared_ptr<Document> doc)
+                                        {
+                                            if (error)
+                                            {
+                                                sendLoadFailure(encoder, res, done);
+                                                return;
+                                            }
+                                            if (!doc)
+                                            {
+                                                res.result(http::status::not_found);
+                                                ResponseEncoders::write(encoder, res, json{{"error", "Document not found"}});
+                                                res.prepare_payload();
+                                                done(nullptr);
+                                                return;
+                                            }
+
+                                            res.result(http::status::ok);
+                                            res.set(http::field::etag, ConditionalRequest::etag(doc->getId(), doc->getVersion(), encoder.tagSuffix()));
+                                            res.set(http::field::last_modified, ConditionalRequest::httpDate(doc->getUpdatedAt()));
+
+                                            if (!ResponseEncoders::getInstance().isJson(encoder))
+                                            {
+                                                ResponseEncoders::write(encoder, res, DocumentController::documentToJson(*doc));
+                                                res.prepare_payload();
+                                                done(nullptr);
+                                                return;
+                                            }
+
+                                            res.set(http::field::content_type, "application/json");
+                                            res.set(http::field::vary, "Accept");
+
+                                            // Large documents go out in chunks escaped straight
+                                            // from the rope instead of as one buffered body
+                                            if (doc->getContentBytes() > AppConfig::getInstance().getResponseStreamingThreshold())
+                                            {
+                                                done(DocumentController::streamDocument(doc));
+                                                return;
+                                            }
+
+                                            JsonWriter writer(res.body());
+                                            DocumentController::writeDocument(writer, *doc);
+                                            res.prepare_payload();
+                                            done(nullptr); });
+}
+
+void DocumentRoutes::sendLoadFailure(const ResponseEncoder &encoder, http::response<http::string_body> &res, const AsyncDone &done)
+{
+    res.result(http::status::internal_server_error);
+    ResponseEncoders::write(encoder, res, json{{"error", "Failed to load document"}});
     res.prepare_payload();
+    done(nullptr);
+}
+
+http::status DocumentRoutes::writeStatus(const http::request<http::string_body> &req, const json &result)
+{
+    if (result.contains("current_version"))
+    {
+        return http::status::precondition_failed;
+    }
+    if (!result.contains("error"))
+    {
+        return http::status::ok;
+    }
+    if (result.value("message", "") == "Document not found")
+    {
+        // If-Match fails when there is no current representation at all
+        return req.find(http::field::if_match) != req.end() ? http::status::precondition_failed
+                                                             : http::status::not_found;
+    }
+    return http::status::internal_server_error;
 }
 
 void DocumentRoutes::handleCreateDocument(
@@ -36,65 +194,106 @@ void DocumentRoutes::handleCreateDocument(
 {
     try
     {
-        auto data = json::parse(req.body());
+        auto data = RequestBody::parseCreateDocument(req.body());
         documentController.createDocument(
-            data["title"],
-            data["content"],
-            data["owner"]);
+            std::string(data.title),
+            data.content,
+            std::string(data.owner));
 
         res.result(http::status::created);
-        res.set(http::field::content_type, "application/json");
-        res.body() = json{{"message", "Document created successfully"}}.dump();
+        ResponseEncoders::write(req, res, json{{"message", "Document created successfully"}});
     }
     catch (const std::exception &e)
     {
         res.result(http::status::bad_request);
-        res.body() = json{{"error", e.what()}}.dump();
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
     }
     res.prepare_payload();
 }
 
 void DocumentRoutes::handleUpdateDocument(
     const http::request<http::string_body> &req,
-    http::response<http::string_body> &res)
+    http::response<http::string_body> &res,
+    const RouteParams &params)
+{
+    try
+    {
+        auto changes = RequestBody::parseDocumentChanges(req.body());
+        int id = documentId(req, params);
+        auto result = documentController.updateDocument(id, changes, ConditionalRequest::ifMatchVersion(req, id));
+
+        res.result(writeStatus(req, result));
+        const auto &encoder = ResponseEncoders::getInstance().negotiate(req);
+        setEtag(res, result, encoder);
+        ResponseEncoders::write(encoder, res, result);
+    }
+    catch (const std::exception &e)
+    {
+        res.result(http::status::bad_request);
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
+    }
+    res.prepare_payload();
+}
+
+void DocumentRoutes::handlePatchDocument(
+    const http::request<http::string_body> &req,
+    http::response<http::string_body> &res,
+    const RouteParams &params)
 {
     try
     {
         auto data = json::parse(req.body());
-        auto [path, queryString] = RouteManager::splitPathAndQuery(std::string(req.target()));
-        QueryParams params = RouteManager::parseQueryParameters(queryString);
-        int id = std::stoi(params["id"]);
-        auto result = documentController.updateDocument(id, data);
+        int id = documentId(req, params);
+        // If-Match can stand in for base_version; a stale tag is then a
+        // failed precondition rather than an edit conflict
+        auto expectedVersion = ConditionalRequest::ifMatchVersion(req, id);
+        if (expectedVersion && !data.contains("base_version"))
+        {
+            data["base_version"] = *expectedVersion;
+        }
+        auto result = documentController.patchDocument(id, data);
 
-        res.result(http::status::ok);
-        res.set(http::field::content_type, "application/json");
-        res.body() = result.dump();
+        if (result.contains("current_version"))
+        {
+            res.result(expectedVersion ? http::status::precondition_failed : http::status::conflict);
+        }
+        else if (result.contains("error"))
+        {
+            res.result(http::status::bad_request);
+        }
+        else
+        {
+            res.result(http::status::ok);
+        }
+        const auto &encoder = ResponseEncoders::getInstance().negotiate(req);
+        setEtag(res, result, encoder);
+        ResponseEncoders::write(encoder, res, result);
     }
     catch (const std::exception &e)
     {
         res.result(http::status::bad_request);
-        res.body() = json{{"error", e.what()}}.dump();
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
     }
     res.prepare_payload();
 }
 
 void DocumentRoutes::handleDeleteDocument(
     const http::request<http::string_body> &req,
-    http::response<http::string_body> &res)
+    http::response<http::string_body> &res,
+    const RouteParams &params)
 {
     try
     {
-        int id = 1; // TODO: Extract ID from URL params
-        auto result = documentController.deleteDocument(id);
+        int id = documentId(req, params);
+        auto result = documentController.deleteDocument(id, ConditionalRequest::ifMatchVersion(req, id));
 
-        res.result(http::status::ok);
-        res.set(http::field::content_type, "application/json");
-        res.body() = result.dump();
+        res.result(writeStatus(req, result));
+        ResponseEncoders::write(req, res, result);
     }
     catch (const std::exception &e)
     {
         res.result(http::status::bad_request);
-        res.body() = json{{"error", e.what()}}.dump();
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
     }
     res.prepare_payload();
 }
@@ -105,26 +304,110 @@ void DocumentRoutes::handleSearchDocuments(
 {
     try
     {
-        auto [path, queryString] = RouteManager::splitPathAndQuery(std::string(req.target()));
-        auto params = RouteManager::parseQueryParameters(queryString);
+        QueryString params(std::string_view(req.target().data(), req.target().size()));
 
-        std::string query = params["q"];
-        std::string author_id = params["author_id"];
+        std::string query = params.get<std::string>("q");
+        int author_id = params.get<int>("author_id", -1);
+        int limit = std::clamp(params.get<int>("limit", 20), 1, 100);
+        std::string cursor = params.get<std::string>("cursor", "");
         if (query.empty())
         {
             throw std::invalid_argument("Query parameter 'q' is required");
         }
-        auto result = documentController.searchDocuments(query, std::stoi(author_id));
-
         res.result(http::status::ok);
-        res.set(http::field::content_type, "application/json");
-        res.body() = result.dump();
+        const auto &encoder = ResponseEncoders::getInstance().negotiate(req);
+        if (ResponseEncoders::getInstance().isJson(encoder))
+        {
+            res.set(http::field::content_type, "application/json");
+            res.set(http::field::vary, "Accept");
+            res.body() = documentController.searchDocumentsJson(query, author_id, limit, cursor);
+        }
+        else
+        {
+            ResponseEncoders::write(encoder, res, documentController.searchDocuments(query, author_id, limit, cursor));
+        }
     }
     catch (const std::exception &e)
     {
         Logger::error({"Failed to search documents: " + std::string(e.what())});
         res.result(http::status::bad_request);
-        res.body() = json{{"error", e.what()}}.dump();
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
+    }
+    res.prepare_payload();
+}
+
+void DocumentRoutes::handleGetDocumentVersions(
+    const http::request<http::string_body> &req,
+    http::response<http::string_body> &res,
+    const RouteParams &params)
+{
+    try
+    {
+        QueryString query(std::string_view(req.target().data(), req.target().size()));
+
+        int id = documentId(req, params);
+        int limit = std::clamp(query.get<int>("limit", 50), 1, 100);
+        int before = query.get<int>("before", 0);
+        auto result = documentController.getDocumentVersions(id, limit, before);
+
+        res.result(http::status::ok);
+        ResponseEncoders::write(req, res, result);
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to list document versions: " + std::string(e.what())});
+        res.result(http::status::bad_request);
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
+    }
+    res.prepare_payload();
+}
+
+void DocumentRoutes::handleGetDocumentVersion(
+    const http::request<http::string_body> &req,
+    http::response<http::string_body> &res,
+    const RouteParams &params)
+{
+    try
+    {
+        int id = documentId(req, params);
+        int version = std::stoi(std::string(params.get("version")));
+        auto result = documentController.getDocumentVersion(id, version);
+
+        res.result(result.contains("error") ? http::status::not_found : http::status::ok);
+        ResponseEncoders::write(req, res, result);
+    }
+    catch (const std::exception &e)
+    {
+        res.result(http::status::bad_request);
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
+    }
+    res.prepare_payload();
+}
+
+void DocumentRoutes::handleGetAuthorDocuments(
+    const http::request<http::string_body> &req,
+    http::response<http::string_body> &res,
+    const RouteParams &params)
+{
+    try
+    {
+        QueryString query(std::string_view(req.target().data(), req.target().size()));
+
+        int author_id = std::stoi(std::string(params.get("author_id")));
+        int limit = std::clamp(query.get<int>("limit", 20), 1, 100);
+        std::string cursor = query.get<std::string>("cursor", "");
+        // Private documents are listed to their author only
+        bool includePrivate = requestAuthorId(req) == author_id;
+        auto result = documentController.getAuthorDocuments(author_id, includePrivate, limit, cursor);
+
+        res.result(http::status::ok);
+        ResponseEncoders::write(req, res, result);
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to list documents of author: " + std::string(e.what())});
+        res.result(http::status::bad_request);
+        ResponseEncoders::write(req, res, json{{"error", e.what()}});
     }
     res.prepare_payload();
 }
@@ -133,8 +416,15 @@ void DocumentRoutes::registerRoutes()
 {
     Logger::info({"Registering document routes"});
     RouteManager::addRoute("/documents/search", "GET", handleSearchDocuments);
-    RouteManager::addRoute("/documents", "GET", handleGetDocument);
+    RouteManager::addAsyncRoute("/documents", "GET", handleGetDocument);
     RouteManager::addRoute("/documents", "POST", handleCreateDocument);
     RouteManager::addRoute("/documents", "PUT", handleUpdateDocument);
     RouteManager::addRoute("/documents", "DELETE", handleDeleteDocument);
+    RouteManager::addAsyncRoute("/documents/{id}", "GET", handleGetDocument);
+    RouteManager::addRoute("/documents/{id}", "PUT", handleUpdateDocument);
+    RouteManager::addRoute("/documents/{id}", "PATCH", handlePatchDocument);
+    RouteManager::addRoute("/documents/{id}", "DELETE", handleDeleteDocument);
+    RouteManager::addRoute("/documents/{id}/versions", "GET", handleGetDocumentVersions);
+    RouteManager::addRoute("/documents/{id}/versions/{version}", "GET", handleGetDocumentVersion);
+    RouteManager::addRoute("/authors/{author_id}/documents", "GET", handleGetAuthorDocuments);
 }
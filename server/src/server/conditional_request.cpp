@@ -0,0 +1,242 @@
+#include <server/conditional_request.hpp>
+#include <array>
+#include <charconv>
+#include <cstdio>
+
+namespace
+{
+    constexpr std::array<const char *, 7> WEEKDAYS = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+    constexpr std::array<const char *, 12> MONTHS = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                      "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+    // Days since 1970-01-01 of a proleptic Gregorian date, and back; avoids
+    // timegm/gmtime_r, which are neither portable nor needed for UTC
+    long long daysFromCivil(long long year, unsigned month, unsigned day)
+    {
+        year -= month <= 2;
+        long long era = (year >= 0 ? year : year - 399) / 400;
+        unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+        unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + static_cast<long long>(dayOfEra) - 719468;
+    }
+
+    void civilFromDays(long long days, long long &year, unsigned &month, unsigned &day)
+    {
+        days += 719468;
+        long long era = (days >= 0 ? days : days - 146096) / 146097;
+        unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+        unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        unsigned shiftedMonth = (5 * dayOfYear + 2) / 153;
+        day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+        month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+        year = static_cast<long long>(yearOfEra) + era * 400 + (month <= 2);
+    }
+
+    bool parseNumber(std::string_view text, int &value)
+    {
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+
+    // Entity tags compare equal under the weak comparison when their opaque
+    // parts match, whatever their W/ prefixes
+    std::string_view opaqueTag(std::string_view tag)
+    {
+        if (tag.substr(0, 2) == "W/")
+        {
+            tag.remove_prefix(2);
+        }
+        return tag;
+    }
+}
+
+std::string ConditionalRequest::etag(int id, int version, std::string_view variant)
+{
+    return etag(std::to_string(id) + "-" + std::to_string(version), variant);
+}
+
+std::string ConditionalRequest::etag(std::string_view fingerprint, std::string_view variant)
+{
+    std::string tag = "\"" + std::string(fingerprint);
+    if (!variant.empty())
+    {
+        tag += "+";
+        tag += variant;
+    }
+    return tag + "\"";
+}
+
+template <typename Visitor>
+bool ConditionalRequest::forEachTag(std::string_view value, Visitor &&visit)
+{
+    while (!value.empty())
+    {
+        std::size_t comma = value.find(',');
+        std::string_view tag = value.substr(0, comma);
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+        while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t'))
+        {
+            tag.remove_prefix(1);
+        }
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t'))
+        {
+            tag.remove_suffix(1);
+        }
+
+        if (!tag.empty() && visit(tag))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<int> ConditionalRequest::ifMatchVersion(const http::request<http::string_body> &req, int id)
+{
+    auto header = req.find(http::field::if_match);
+    if (header == req.end())
+    {
+        return std::nullopt;
+    }
+
+    bool any = false;
+    std::optional<int> version;
+    forEachTag(std::string_view(header->value().data(), header->value().size()),
+               [&](std::string_view tag)
+               {
+                   if (tag == "*")
+                   {
+                       any = true;
+                       return true;
+                   }
+                   version = parseTag(tag, id);
+                   return version.has_value();
+               });
+    if (any)
+    {
+        return std::nullopt;
+    }
+    return version ? version : -1;
+}
+
+bool ConditionalRequest::isConditional(const http::request<http::string_body> &req)
+{
+    return req.find(http::field::if_none_match) != req.end() ||
+           req.find(http::field::if_modified_since) != req.end();
+}
+
+bool ConditionalRequest::notModified(const http::request<http::string_body> &req, std::string_view etag,
+                                     std::optional<time_t> lastModified)
+{
+    auto noneMatch = req.find(http::field::if_none_match);
+    if (noneMatch != req.end())
+    {
+        return forEachTag(std::string_view(noneMatch->value().data(), noneMatch->value().size()),
+                          [&](std::string_view tag)
+                          {
+                              return tag == "*" || opaqueTag(tag) == opaqueTag(etag);
+                          });
+    }
+
+    auto modifiedSince = req.find(http::field::if_modified_since);
+    if (modifiedSince == req.end() || !lastModified)
+    {
+        return false;
+    }
+    auto since = parseHttpDate(std::string_view(modifiedSince->value().data(), modifiedSince->value().size()));
+    return since && *lastModified <= *since;
+}
+
+void ConditionalRequest::setNotModified(http::response<http::string_body> &res, std::string_view etag,
+                                        std::optional<time_t> lastModified)
+{
+    res.result(http::status::not_modified);
+    res.set(http::field::etag, boost::beast::string_view(etag.data(), etag.size()));
+    if (lastModified)
+    {
+        res.set(http::field::last_modified, httpDate(*lastModified));
+    }
+    res.body().clear();
+    res.prepare_payload();
+}
+
+std::string ConditionalRequest::httpDate(time_t time)
+{
+    long long seconds = static_cast<long long>(time);
+    long long days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    long long secondOfDay = seconds - days * 86400;
+
+    long long year = 0;
+    unsigned month = 0;
+    unsigned day = 0;
+    civilFromDays(days, year, month, day);
+
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%s, %02u %s %04lld %02lld:%02lld:%02lld GMT",
+                  WEEKDAYS[((days % 7) + 7) % 7], day, MONTHS[month - 1], year,
+                  secondOfDay / 3600, secondOfDay / 60 % 60, secondOfDay % 60);
+    return buffer;
+}
+
+std::optional<time_t> ConditionalRequest::parseHttpDate(std::string_view date)
+{
+    // "Sun, 06 Nov 1994 08:49:37 GMT": fixed width, so fields are at fixed offsets
+    if (date.size() != 29 || date[3] != ',' || date[4] != ' ' || date[7] != ' ' || date[11] != ' ' ||
+        date[16] != ' ' || date[19] != ':' || date[22] != ':' || date.substr(25) != " GMT")
+    {
+        return std::nullopt;
+    }
+
+    unsigned month = 0;
+    while (month < MONTHS.size() && date.substr(8, 3) != MONTHS[month])
+    {
+        month++;
+    }
+
+    int day = 0;
+    int year = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    if (month == MONTHS.size() || !parseNumber(date.substr(5, 2), day) || !parseNumber(date.substr(12, 4), year) ||
+        !parseNumber(date.substr(17, 2), hour) || !parseNumber(date.substr(20, 2), minute) ||
+        !parseNumber(date.substr(23, 2), second) || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+    {
+        return std::nullopt;
+    }
+
+    long long days = daysFromCivil(year, month + 1, static_cast<unsigned>(day));
+    return static_cast<time_t>(days * 86400 + hour * 3600 + minute * 60 + second);
+}
+
+std::optional<int> ConditionalRequest::parseTag(std::string_view tag, int id)
+{
+    if (tag.size() < 2 || tag.front() != '"' || tag.back() != '"')
+    {
+        return std::nullopt;
+    }
+    tag = tag.substr(1, tag.size() - 2);
+    tag = tag.substr(0, tag.find('+'));
+
+    std::size_t dash = tag.find('-');
+    if (dash == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+
+    int tagId = 0;
+    int version = 0;
+    auto idEnd = tag.data() + dash;
+    auto versionEnd = tag.data() + tag.size();
+    auto [idPtr, idError] = std::from_chars(tag.data(), idEnd, tagId);
+    auto [versionPtr, versionError] = std::from_chars(idEnd + 1, versionEnd, version);
+    if (idError != std::errc() || idPtr != idEnd || versionError != std::errc() || versionPtr != versionEnd ||
+        tagId != id)
+    {
+        return std::nullopt;
+    }
+    return version;
+}
@@ -1,16 +1,65 @@
 #include <server/http_server.hpp>
 #include <iostream>
 #include <server/route_manager.hpp>
+#include <server/websocket_session.hpp>
+#include <server/request_body.hpp>
+#include <config/app_config.hpp>
+#include <db/db_executor.hpp>
+#include <db/db_manager.hpp>
+#include <services/document_cache.hpp>
+#include <services/collaboration.hpp>
+#include <nlohmann/json.hpp>
 #include <utils/logger.hpp>
+#include <boost/asio/strand.hpp>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#ifdef SO_REUSEPORT
+using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
 
 HttpServer::HttpServer(
     net::io_context &io_context,
     unsigned short port,
-    unsigned int thread_count) : io_context_(io_context),
-                                 acceptor_(io_context_, tcp::endpoint(tcp::v4(), port)),
-                                 thread_count_(thread_count)
+    unsigned int thread_count,
+    bool shard_per_thread,
+    bool pin_threads) : io_context_(io_context),
+                        thread_count_(std::max(1u, thread_count)),
+                        shard_per_thread_(shard_per_thread),
+                        pin_threads_(pin_threads)
 {
-    do_accept();
+#ifndef SO_REUSEPORT
+    if (shard_per_thread_)
+    {
+        Logger::warn({"SO_REUSEPORT is not available on this platform, falling back to a shared io_context"});
+        shard_per_thread_ = false;
+    }
+#endif
+
+    tcp::endpoint endpoint(tcp::v4(), port);
+
+    if (!shard_per_thread_)
+    {
+        open_acceptor(io_context_, endpoint, false);
+        return;
+    }
+
+    for (unsigned int i = 1; i < thread_count_; ++i)
+    {
+        shard_contexts_.push_back(std::make_unique<net::io_context>(1));
+    }
+    for (unsigned int i = 0; i < thread_count_; ++i)
+    {
+        open_acceptor(context_for_thread(i), endpoint, true);
+    }
+    Logger::info({"Sharded server with " + std::to_string(thread_count_) + " io_contexts"});
 }
 
 void HttpServer::run()
@@ -18,8 +67,14 @@ void HttpServer::run()
     // Spawn worker threads
     for (unsigned int i = 0; i < thread_count_; ++i)
     {
-        worker_threads_.emplace_back([this]()
-                                     { io_context_.run(); });
+        net::io_context &context = shard_per_thread_ ? context_for_thread(i) : io_context_;
+        worker_threads_.emplace_back([this, &context, i]()
+                                     {
+                                         if (pin_threads_)
+                                         {
+                                             pin_thread(i);
+                                         }
+                                         context.run(); });
     }
 
     // Wait for all threads to complete
@@ -29,22 +84,77 @@ void HttpServer::run()
     }
 }
 
+// Safe to call from a handler on one of the server's own threads: it only
+// stops the contexts, and run() returns once every thread has finished.
 void HttpServer::stop()
 {
     io_context_.stop();
-    for (auto &thread : worker_threads_)
+    for (auto &context : shard_contexts_)
     {
-        if (thread.joinable())
-        {
-            thread.join();
-        }
+        context->stop();
+    }
+}
+
+net::io_context &HttpServer::context_for_thread(unsigned int index)
+{
+    return index == 0 ? io_context_ : *shard_contexts_[index - 1];
+}
+
+void HttpServer::open_acceptor(net::io_context &io_context, const tcp::endpoint &endpoint, bool use_reuse_port)
+{
+    auto acceptor = std::make_unique<tcp::acceptor>(io_context);
+    acceptor->open(endpoint.protocol());
+    acceptor->set_option(net::socket_base::reuse_address(true));
+#ifdef SO_REUSEPORT
+    if (use_reuse_port)
+    {
+        // Every shard binds the same port; the kernel spreads incoming
+        // connections across the listening sockets.
+        acceptor->set_option(reuse_port(true));
     }
+#endif
+    acceptor->bind(endpoint);
+    acceptor->listen(net::socket_base::max_listen_connections);
+
+    do_accept(*acceptor);
+    acceptors_.push_back(std::move(acceptor));
 }
 
-void HttpServer::do_accept()
+void HttpServer::pin_thread(unsigned int cpu)
 {
-    acceptor_.async_accept(
-        [this](beast::error_code ec, tcp::socket socket)
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    cpu %= cores;
+#if defined(__linux__)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0)
+    {
+        Logger::warn({"Failed to pin worker thread to CPU " + std::to_string(cpu)});
+    }
+#elif defined(_WIN32)
+    if (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) == 0)
+    {
+        Logger::warn({"Failed to pin worker thread to CPU " + std::to_string(cpu)});
+    }
+#else
+    Logger::warn({"CPU pinning is not supported on this platform"});
+#endif
+}
+
+void HttpServer::do_accept(tcp::acceptor &acceptor)
+{
+    // A shard's io_context is only ever run by one thread, so its sessions
+    // are already serialised. On the shared context each connection gets its
+    // own strand so that its read and write completions never run
+    // concurrently on different worker threads.
+    net::any_io_executor executor = shard_per_thread_
+                                        ? net::any_io_executor(acceptor.get_executor())
+                                        : net::any_io_executor(net::make_strand(io_context_));
+
+    acceptor.async_accept(
+        executor,
+        [this, &acceptor](beast::error_code ec, tcp::socket socket)
         {
             if (!ec)
             {
@@ -53,13 +163,13 @@ void HttpServer::do_accept()
             }
 
             // Continue accepting new connections
-            do_accept();
+            do_accept(acceptor);
         });
 }
 
 // HttpSession Implementation
 HttpServer::HttpSession::HttpSession(tcp::socket &&socket)
-    : socket_(std::move(socket)) {}
+    : stream_(std::move(socket)) {}
 
 void HttpServer::HttpSession::start()
 {
@@ -68,66 +178,458 @@ void HttpServer::HttpSession::start()
 
 void HttpServer::HttpSession::read_request()
 {
+    auto &config = AppConfig::getInstance();
+
+    // Stop parsing ahead once the pipeline is full; reading resumes as soon as
+    // the oldest response has been written.
+    if (reading_ || closing_ || upgrade_ || pipeline_.size() >= config.getMaxPipelinedRequests())
+    {
+        return;
+    }
+
+    reading_ = true;
+    parser_.emplace();
+    parser_->body_limit(config.getMaxRequestBodySize());
+    arm_idle_deadline();
+
     auto self = shared_from_this();
 
-    http::async_read(socket_, buffer_, request_,
+    http::async_read_header(stream_, buffer_, *parser_,
+                            [self](beast::error_code ec, std::size_t bytes_transferred)
+                            {
+                                self->on_read_header(ec);
+                            });
+}
+
+void HttpServer::HttpSession::on_read_header(beast::error_code ec)
+{
+    if (ec || parser_->is_done())
+    {
+        on_read(ec);
+        return;
+    }
+
+    // Room for the padding the JSON parser reads past the end, so that
+    // RequestBody can parse the body where it is instead of copying it
+    if (auto length = parser_->content_length())
+    {
+        parser_->get().body().reserve(*length + RequestBody::PADDING);
+    }
+
+    auto self = shared_from_this();
+    http::async_read(stream_, buffer_, *parser_,
                      [self](beast::error_code ec, std::size_t bytes_transferred)
                      {
-                         if (!ec)
-                         {
-                             self->process_request();
-                         }
+                         self->on_read(ec);
                      });
 }
 
-void HttpServer::HttpSession::process_request()
+void HttpServer::HttpSession::on_read(beast::error_code ec)
 {
-    if (request_.target() == "/health")
+    reading_ = false;
+
+    if (ec == http::error::body_limit)
     {
-        handle_health_check();
+        // The rest of the body is still on the wire, so the connection cannot
+        // be reused; answer after the queued responses and then close.
+        closing_ = true;
+        auto exchange = std::make_shared<Exchange>();
+        exchange->response.version(parser_->get().version());
+        pipeline_.push_back(exchange);
+        handle_payload_too_large(*exchange);
         return;
     }
 
-    if (RouteManager::handleRequest(request_, response_))
+    if (ec)
     {
-        write_response();
+        // The client closed the connection or went idle; finish writing
+        // whatever is still queued and then close.
+        if (ec != http::error::end_of_stream && ec != beast::error::timeout)
+        {
+            Logger::debug({"Error reading request: " + ec.message()});
+        }
+        closing_ = true;
+        if (!writing_ && pipeline_.empty())
+        {
+            do_close();
+        }
         return;
     }
 
-    handle_not_found();
+    auto exchange = std::make_shared<Exchange>();
+    exchange->request = parser_->release();
+
+    // Hand the connection over to a WebSocket session once every earlier
+    // response has gone out. Reading stops here either way: whatever follows
+    // the upgrade request belongs to the WebSocket.
+    if (websocket::is_upgrade(exchange->request))
+    {
+        int document_id = WebSocketSession::collaboration_target(exchange->request.target());
+        if (document_id >= 0)
+        {
+            upgrade_.emplace(std::move(exchange->request));
+            upgrade_document_id_ = document_id;
+            if (pipeline_.empty() && !writing_)
+            {
+                start_upgrade();
+            }
+            return;
+        }
+    }
+
+    if (!exchange->request.keep_alive())
+    {
+        closing_ = true;
+    }
+
+    pipeline_.push_back(exchange);
+    process_request(exchange);
+
+    read_request();
 }
 
-void HttpServer::HttpSession::handle_health_check()
+void HttpServer::HttpSession::process_request(const std::shared_ptr<Exchange> &exchange)
 {
-    response_.version(request_.version());
-    response_.result(http::status::ok);
-    response_.set(http::field::server, "Boost Beast Server");
-    response_.set(http::field::content_type, "application/json");
-    response_.body() = R"({"status": "healthy", "message": "Server is running"})";
-    response_.prepare_payload();
+    auto &request = exchange->request;
+    auto &response = exchange->response;
 
+    response.version(request.version());
+    response.keep_alive(request.keep_alive());
+
+    if (request.target() == "/health")
+    {
+        handle_health_check(*exchange);
+        return;
+    }
+
+    auto self = shared_from_this();
+
+    // Non-blocking handlers run right here and signal completion themselves
+    try
+    {
+        bool dispatched = RouteManager::handleRequestAsync(
+            request, response,
+            [self, exchange](std::shared_ptr<ResponseStream> stream)
+            {
+                net::post(self->stream_.get_executor(),
+                          [self, exchange, stream = std::move(stream)]()
+                          {
+                              self->complete_request(*exchange, true, stream);
+                          });
+            });
+        if (dispatched)
+        {
+            return;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Unhandled exception in route handler: " + std::string(e.what())});
+        response.result(http::status::internal_server_error);
+        response.set(http::field::content_type, "text/plain");
+        response.body() = "500 Internal Server Error";
+        complete_request(*exchange, true);
+        return;
+    }
+
+    // Blocking route handlers hit the database, so they run on the database
+    // executor and hand the finished response back to this session's executor.
+    bool queued = DatabaseExecutor::getInstance().post(
+        [self, exchange]()
+        {
+            bool handled = false;
+            try
+            {
+                handled = RouteManager::handleRequest(exchange->request, exchange->response);
+            }
+            catch (const std::exception &e)
+            {
+                Logger::error({"Unhandled exception in route handler: " + std::string(e.what())});
+                exchange->response.result(http::status::internal_server_error);
+                exchange->response.set(http::field::content_type, "text/plain");
+                exchange->response.body() = "500 Internal Server Error";
+                handled = true;
+            }
+
+            net::post(self->stream_.get_executor(),
+                      [self, exchange, handled]()
+                      {
+                          self->complete_request(*exchange, handled);
+                      });
+        });
+
+    if (!queued)
+    {
+        handle_service_unavailable(*exchange);
+    }
+}
+
+void HttpServer::HttpSession::complete_request(Exchange &exchange, bool handled, std::shared_ptr<ResponseStream> stream)
+{
+    if (!handled)
+    {
+        handle_not_found(exchange);
+        return;
+    }
+
+    if (stream)
+    {
+        if (exchange.request.version() >= 11)
+        {
+            exchange.stream = std::move(stream);
+            exchange.ready = true;
+            write_response();
+            return;
+        }
+
+        // HTTP/1.0 has no chunked encoding; such clients get the whole body
+        std::string piece;
+        while (stream->next(piece))
+        {
+            exchange.response.body() += piece;
+        }
+    }
+
+    exchange.response.prepare_payload();
+    exchange.ready = true;
+    write_response();
+}
+
+void HttpServer::HttpSession::handle_health_check(Exchange &exchange)
+{
+    auto &response = exchange.response;
+    response.result(http::status::ok);
+    response.set(http::field::server, "Boost Beast Server");
+    response.set(http::field::content_type, "application/json");
+    auto pool = DatabaseManager::getInstance().getMetrics();
+    auto cache = DocumentCache::getInstance().getMetrics();
+    auto rooms = CollaborationManager::getInstance().activeRooms();
+    nlohmann::json body = {
+        {"status", "healthy"},
+        {"message", "Server is running"},
+        {"database_pool", {{"max_size", pool.maxSize},
+                           {"open", pool.openConnections},
+                           {"in_use", pool.inUse},
+                           {"idle", pool.idle},
+                           {"acquisitions", pool.acquisitions},
+                           {"timeouts", pool.timeouts},
+                           {"avg_acquire_us", pool.acquisitions ? pool.totalAcquireMicros / pool.acquisitions : 0},
+                           {"max_acquire_us", pool.maxAcquireMicros}}},
+        {"document_cache", {{"byte_budget", cache.byteBudget},
+                            {"bytes", cache.bytes},
+                            {"entries", cache.entries},
+                            {"hits", cache.hits},
+                            {"misses", cache.misses},
+                            {"evictions", cache.evictions}}},
+        {"collaboration", {{"rooms", rooms}}}};
+    response.body() = body.dump();
+    response.prepare_payload();
+
+    exchange.ready = true;
     write_response();
 }
 
-void HttpServer::HttpSession::handle_not_found()
+void HttpServer::HttpSession::handle_not_found(Exchange &exchange)
 {
-    response_.version(request_.version());
-    response_.result(http::status::not_found);
-    response_.set(http::field::server, "Boost Beast Server");
-    response_.set(http::field::content_type, "text/plain");
-    response_.body() = "404 Not Found";
-    response_.prepare_payload();
+    auto &response = exchange.response;
+    response.result(http::status::not_found);
+    response.set(http::field::server, "Boost Beast Server");
+    response.set(http::field::content_type, "text/plain");
+    response.body() = "404 Not Found";
+    response.prepare_payload();
 
+    exchange.ready = true;
+    write_response();
+}
+
+void HttpServer::HttpSession::handle_service_unavailable(Exchange &exchange)
+{
+    auto &response = exchange.response;
+    response.result(http::status::service_unavailable);
+    response.set(http::field::server, "Boost Beast Server");
+    response.set(http::field::content_type, "text/plain");
+    response.set(http::field::retry_after, "1");
+    response.body() = "503 Service Unavailable";
+    response.prepare_payload();
+
+    exchange.ready = true;
+    write_response();
+}
+
+void HttpServer::HttpSession::handle_payload_too_large(Exchange &exchange)
+{
+    auto &response = exchange.response;
+    response.result(http::status::payload_too_large);
+    response.set(http::field::server, "Boost Beast Server");
+    response.set(http::field::content_type, "text/plain");
+    response.keep_alive(false);
+    response.body() = "413 Payload Too Large";
+    response.prepare_payload();
+
+    exchange.ready = true;
     write_response();
 }
 
 void HttpServer::HttpSession::write_response()
 {
+    // Responses leave strictly in request order: only the head of the
+    // pipeline may be written, and only once it has been produced.
+    if (writing_ || pipeline_.empty() || !pipeline_.front()->ready)
+    {
+        return;
+    }
+
+    writing_ = true;
     auto self = shared_from_this();
+    auto exchange = pipeline_.front();
+    stream_.expires_after(std::chrono::seconds(AppConfig::getInstance().getKeepAliveTimeoutSeconds()));
 
-    http::async_write(socket_, response_,
-                      [self](beast::error_code ec, std::size_t bytes_transferred)
+    if (exchange->stream)
+    {
+        write_stream(exchange);
+        return;
+    }
+
+    http::async_write(stream_, exchange->response,
+                      [self, exchange](beast::error_code ec, std::size_t bytes_transferred)
                       {
-                          self->socket_.shutdown(tcp::socket::shutdown_send, ec);
+                          self->on_write(ec, exchange->response.need_eof());
                       });
-}
\ No newline at end of file
+}
+
+void HttpServer::HttpSession::write_stream(const std::shared_ptr<Exchange> &exchange)
+{
+    auto self = shared_from_this();
+    exchange->stream_header.emplace(std::move(exchange->response.base()));
+    exchange->stream_header->chunked(true);
+    exchange->stream_serializer.emplace(*exchange->stream_header);
+
+    http::async_write_header(stream_, *exchange->stream_serializer,
+                             [self, exchange](beast::error_code ec, std::size_t bytes_transferred)
+                             {
+                                 if (ec)
+                                 {
+                                     self->on_write(ec, true);
+                                     return;
+                                 }
+                                 self->write_chunk(exchange);
+                             });
+}
+
+void HttpServer::HttpSession::write_chunk(const std::shared_ptr<Exchange> &exchange)
+{
+    auto self = shared_from_this();
+    stream_.expires_after(std::chrono::seconds(AppConfig::getInstance().getKeepAliveTimeoutSeconds()));
+
+    bool more = false;
+    try
+    {
+        // An empty chunk would mark the end of the body, so skip empty pieces
+        while ((more = exchange->stream->next(exchange->chunk)) && exchange->chunk.empty())
+        {
+        }
+    }
+    catch (const std::exception &e)
+    {
+        // The status line is already out; all that is left is to cut the
+        // body short so the client sees an incomplete response
+        Logger::error({"Failed to produce streamed response: " + std::string(e.what())});
+        on_write(net::error::operation_aborted, true);
+        return;
+    }
+
+    if (!more)
+    {
+        net::async_write(stream_, http::make_chunk_last(),
+                         [self, exchange](beast::error_code ec, std::size_t bytes_transferred)
+                         {
+                             self->on_write(ec, exchange->stream_header->need_eof());
+                         });
+        return;
+    }
+
+    net::async_write(stream_, http::make_chunk(net::buffer(exchange->chunk)),
+                     [self, exchange](beast::error_code ec, std::size_t bytes_transferred)
+                     {
+                         if (ec)
+                         {
+                             self->on_write(ec, true);
+                             return;
+                         }
+                         self->write_chunk(exchange);
+                     });
+}
+
+void HttpServer::HttpSession::on_write(beast::error_code ec, bool close)
+{
+    writing_ = false;
+    pipeline_.pop_front();
+
+    if (ec)
+    {
+        Logger::debug({"Error writing response: " + ec.message()});
+        do_close();
+        return;
+    }
+
+    if (close)
+    {
+        do_close();
+        return;
+    }
+
+    if (closing_ && pipeline_.empty())
+    {
+        do_close();
+        return;
+    }
+
+    if (upgrade_ && pipeline_.empty())
+    {
+        start_upgrade();
+        return;
+    }
+
+    write_response();
+    arm_idle_deadline();
+    read_request();
+}
+
+// The keep-alive deadline only runs while nothing is owed to the client. A
+// read-ahead shares the stream's timer with the response it is waiting for,
+// so a handler slower than the timeout must not close the socket under it.
+// A write in progress keeps its own deadline; on_write comes back here.
+void HttpServer::HttpSession::arm_idle_deadline()
+{
+    if (writing_)
+    {
+        return;
+    }
+    if (pipeline_.empty())
+    {
+        stream_.expires_after(std::chrono::seconds(AppConfig::getInstance().getKeepAliveTimeoutSeconds()));
+    }
+    else
+    {
+        stream_.expires_never();
+    }
+}
+
+// This session ends with its last handler once the stream has moved
+void HttpServer::HttpSession::start_upgrade()
+{
+    closing_ = true;
+    http::request<http::string_body> request = std::move(*upgrade_);
+    upgrade_.reset();
+    std::make_shared<WebSocketSession>(std::move(stream_), upgrade_document_id_)->start(std::move(request));
+}
+
+void HttpServer::HttpSession::do_close()
+{
+    closing_ = true;
+    pipeline_.clear();
+    upgrade_.reset();
+
+    beast::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+}
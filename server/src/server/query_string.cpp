@@ -0,0 +1,201 @@
+#include <server/query_string.hpp>
+#include <charconv>
+#include <stdexcept>
+
+namespace
+{
+    bool needsDecoding(std::string_view value)
+    {
+        return value.find_first_of("%+") != std::string_view::npos;
+    }
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // Decodes into storage only when raw contains escapes
+    std::string_view decodeInto(std::string_view raw, std::string &storage)
+    {
+        if (!needsDecoding(raw))
+        {
+            return raw;
+        }
+        storage = QueryString::decode(raw);
+        return storage;
+    }
+
+    template <typename T>
+    T parseInteger(std::string_view key, std::string_view raw)
+    {
+        std::string decoded;
+        std::string_view value = decodeInto(raw, decoded);
+
+        T result{};
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+        if (ec != std::errc() || end != value.data() + value.size() || value.empty())
+        {
+            throw std::invalid_argument("Query parameter '" + std::string(key) + "' is not a valid integer");
+        }
+        return result;
+    }
+}
+
+QueryString::QueryString(std::string_view target)
+{
+    size_t start = target.find('?');
+    if (start == std::string_view::npos)
+    {
+        return;
+    }
+    std::string_view query = target.substr(start + 1);
+
+    // Drop any fragment
+    query = query.substr(0, query.find('#'));
+
+    while (!query.empty())
+    {
+        size_t end = query.find('&');
+        std::string_view pair = query.substr(0, end);
+        query = end == std::string_view::npos ? std::string_view() : query.substr(end + 1);
+        if (pair.empty())
+        {
+            continue;
+        }
+
+        size_t equals = pair.find('=');
+        if (equals == std::string_view::npos)
+        {
+            add(pair, std::string_view());
+        }
+        else
+        {
+            add(pair.substr(0, equals), pair.substr(equals + 1));
+        }
+    }
+}
+
+void QueryString::add(std::string_view key, std::string_view value)
+{
+    if (m_size < inline_capacity)
+    {
+        m_entries[m_size++] = {key, value};
+        return;
+    }
+    m_overflow.push_back({key, value});
+}
+
+const QueryString::Entry *QueryString::find(std::string_view key) const
+{
+    auto matches = [key](const Entry &entry)
+    {
+        // Keys are almost never escaped; only decode when they are
+        return needsDecoding(entry.key) ? decode(entry.key) == key : entry.key == key;
+    };
+
+    for (size_t i = 0; i < m_size; i++)
+    {
+        if (matches(m_entries[i]))
+        {
+            return &m_entries[i];
+        }
+    }
+    for (const auto &entry : m_overflow)
+    {
+        if (matches(entry))
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool QueryString::contains(std::string_view key) const
+{
+    return find(key) != nullptr;
+}
+
+std::optional<std::string_view> QueryString::raw(std::string_view key) const
+{
+    const Entry *entry = find(key);
+    if (!entry)
+    {
+        return std::nullopt;
+    }
+    return entry->value;
+}
+
+std::string_view QueryString::required(std::string_view key) const
+{
+    const Entry *entry = find(key);
+    if (!entry)
+    {
+        throw std::invalid_argument("Query parameter '" + std::string(key) + "' is required");
+    }
+    return entry->value;
+}
+
+std::string QueryString::decode(std::string_view value)
+{
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        char c = value[i];
+        if (c == '+')
+        {
+            decoded.push_back(' ');
+        }
+        else if (c == '%' && i + 2 < value.size() && hexValue(value[i + 1]) >= 0 && hexValue(value[i + 2]) >= 0)
+        {
+            decoded.push_back(static_cast<char>(hexValue(value[i + 1]) * 16 + hexValue(value[i + 2])));
+            i += 2;
+        }
+        else
+        {
+            decoded.push_back(c);
+        }
+    }
+    return decoded;
+}
+
+template <>
+std::string QueryString::get<std::string>(std::string_view key) const
+{
+    std::string_view value = required(key);
+    return needsDecoding(value) ? decode(value) : std::string(value);
+}
+
+template <>
+int QueryString::get<int>(std::string_view key) const
+{
+    return parseInteger<int>(key, required(key));
+}
+
+template <>
+long long QueryString::get<long long>(std::string_view key) const
+{
+    return parseInteger<long long>(key, required(key));
+}
+
+template <>
+bool QueryString::get<bool>(std::string_view key) const
+{
+    std::string decoded;
+    std::string_view value = decodeInto(required(key), decoded);
+    if (value.empty() || value == "true" || value == "1" || value == "yes")
+    {
+        return true;
+    }
+    if (value == "false" || value == "0" || value == "no")
+    {
+        return false;
+    }
+    throw std::invalid_argument("Query parameter '" + std::string(key) + "' is not a valid boolean");
+}
@@ -0,0 +1,168 @@
+#include <server/request_body.hpp>
+#include <simdjson.h>
+#include <optional>
+#include <stdexcept>
+
+static_assert(simdjson::SIMDJSON_PADDING <= RequestBody::PADDING, "RequestBody::PADDING is smaller than simdjson needs");
+
+namespace
+{
+    // Parsers keep their buffers between documents, so each thread reuses one
+    thread_local simdjson::ondemand::parser parser;
+    // Bodies without spare capacity are copied here to get the padding
+    thread_local std::string paddedCopy;
+
+    simdjson::ondemand::document iterate(const std::string &body)
+    {
+        if (body.capacity() - body.size() >= simdjson::SIMDJSON_PADDING)
+        {
+            return parser.iterate(body.data(), body.size(), body.capacity());
+        }
+        paddedCopy.reserve(body.size() + simdjson::SIMDJSON_PADDING);
+        paddedCopy.assign(body);
+        return parser.iterate(paddedCopy.data(), paddedCopy.size(), paddedCopy.capacity());
+    }
+
+    // Calls visit(key, value) for every member of the top-level object
+    template <typename Visitor>
+    void forEachField(const std::string &body, Visitor &&visit)
+    {
+        try
+        {
+            auto document = iterate(body);
+            simdjson::ondemand::object object = document.get_object();
+            for (simdjson::ondemand::field field : object)
+            {
+                std::string_view key = field.unescaped_key();
+                visit(key, field.value());
+            }
+            if (!document.at_end())
+            {
+                throw std::invalid_argument("Unexpected content after the JSON body");
+            }
+        }
+        catch (const simdjson::simdjson_error &e)
+        {
+            throw std::invalid_argument("Invalid JSON body: " + std::string(e.what()));
+        }
+    }
+
+    std::string_view stringValue(simdjson::ondemand::value &value, std::string_view name)
+    {
+        simdjson::ondemand::json_type type = value.type();
+        if (type != simdjson::ondemand::json_type::string)
+        {
+            throw std::invalid_argument("Field '" + std::string(name) + "' must be a string");
+        }
+
+        // Without escapes the text can be used where it is in the input; the
+        // token runs up to the next one, so cut at the closing quote
+        std::string_view token = value.raw_json_token();
+        std::string_view text = token.substr(1, token.find_last_of('"') - 1);
+        if (text.find('\\') == std::string_view::npos)
+        {
+            return text;
+        }
+        return value.get_string();
+    }
+
+    bool boolValue(simdjson::ondemand::value &value, std::string_view name)
+    {
+        simdjson::ondemand::json_type type = value.type();
+        if (type != simdjson::ondemand::json_type::boolean)
+        {
+            throw std::invalid_argument("Field '" + std::string(name) + "' must be a boolean");
+        }
+        return value.get_bool();
+    }
+
+    std::string_view required(const std::optional<std::string_view> &field, const char *name)
+    {
+        if (!field)
+        {
+            throw std::invalid_argument("Missing field '" + std::string(name) + "'");
+        }
+        return *field;
+    }
+}
+
+CreateDocumentRequest RequestBody::parseCreateDocument(const std::string &body)
+{
+    std::optional<std::string_view> title;
+    std::optional<std::string_view> content;
+    std::optional<std::string_view> owner;
+    forEachField(body, [&](std::string_view key, simdjson::ondemand::value &value)
+                 {
+                     if (key == "title")
+                     {
+                         title = stringValue(value, key);
+                     }
+                     else if (key == "content")
+                     {
+                         content = stringValue(value, key);
+                     }
+                     else if (key == "owner")
+                     {
+                         owner = stringValue(value, key);
+                     } });
+    return CreateDocumentRequest{required(title, "title"), required(content, "content"), required(owner, "owner")};
+}
+
+DocumentChanges RequestBody::parseDocumentChanges(const std::string &body)
+{
+    DocumentChanges changes;
+    forEachField(body, [&](std::string_view key, simdjson::ondemand::value &value)
+                 {
+                     if (key == "title")
+                     {
+                         changes.title = stringValue(value, key);
+                     }
+                     else if (key == "content")
+                     {
+                         changes.content = stringValue(value, key);
+                     }
+                     else if (key == "is_public")
+                     {
+                         changes.isPublic = boolValue(value, key);
+                     } });
+    return changes;
+}
+
+RegistrationRequest RequestBody::parseRegistration(const std::string &body)
+{
+    std::optional<std::string_view> name;
+    std::optional<std::string_view> email;
+    std::optional<std::string_view> password;
+    forEachField(body, [&](std::string_view key, simdjson::ondemand::value &value)
+                 {
+                     if (key == "name")
+                     {
+                         name = stringValue(value, key);
+                     }
+                     else if (key == "email")
+                     {
+                         email = stringValue(value, key);
+                     }
+                     else if (key == "password")
+                     {
+                         password = stringValue(value, key);
+                     } });
+    return RegistrationRequest{required(name, "name"), required(email, "email"), required(password, "password")};
+}
+
+LoginRequest RequestBody::parseLogin(const std::string &body)
+{
+    std::optional<std::string_view> email;
+    std::optional<std::string_view> password;
+    forEachField(body, [&](std::string_view key, simdjson::ondemand::value &value)
+                 {
+                     if (key == "email")
+                     {
+                         email = stringValue(value, key);
+                     }
+                     else if (key == "password")
+                     {
+                         password = stringValue(value, key);
+                     } });
+    return LoginRequest{required(email, "email"), required(password, "password")};
+}
@@ -0,0 +1,179 @@
+#include <server/response_encoder.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace
+{
+    class JsonEncoder : public ResponseEncoder
+    {
+    public:
+        std::string_view mediaType() const override { return "application/json"; }
+        std::string_view tagSuffix() const override { return ""; }
+        std::string encode(const nlohmann::json &value) const override { return value.dump(); }
+    };
+
+    class CborEncoder : public ResponseEncoder
+    {
+    public:
+        std::string_view mediaType() const override { return "application/cbor"; }
+        std::string_view tagSuffix() const override { return "cbor"; }
+        std::string encode(const nlohmann::json &value) const override
+        {
+            std::string out;
+            nlohmann::json::to_cbor(value, out);
+            return out;
+        }
+    };
+
+    class MessagePackEncoder : public ResponseEncoder
+    {
+    public:
+        std::string_view mediaType() const override { return "application/msgpack"; }
+        std::string_view tagSuffix() const override { return "msgpack"; }
+        std::string encode(const nlohmann::json &value) const override
+        {
+            std::string out;
+            nlohmann::json::to_msgpack(value, out);
+            return out;
+        }
+    };
+
+    std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    bool equalsIgnoreCase(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() &&
+               std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y)
+                          { return std::tolower(x) == std::tolower(y); });
+    }
+
+    std::string lowerCase(std::string_view text)
+    {
+        std::string lower(text);
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return lower;
+    }
+}
+
+ResponseEncoders::ResponseEncoders()
+{
+    add(std::make_shared<JsonEncoder>());
+    add(std::make_shared<CborEncoder>());
+    add(std::make_shared<MessagePackEncoder>(), {"application/x-msgpack", "application/vnd.msgpack"});
+}
+
+void ResponseEncoders::add(std::shared_ptr<const ResponseEncoder> encoder, std::vector<std::string> aliases)
+{
+    Entry entry{std::move(encoder), {}};
+    entry.mediaTypes.push_back(lowerCase(entry.encoder->mediaType()));
+    for (const auto &alias : aliases)
+    {
+        entry.mediaTypes.push_back(lowerCase(alias));
+    }
+    m_entries.push_back(std::move(entry));
+}
+
+const ResponseEncoder &ResponseEncoders::negotiate(const http::request<http::string_body> &req) const
+{
+    auto header = req.find(http::field::accept);
+    if (header == req.end())
+    {
+        return json();
+    }
+    std::string_view accept(header->value().data(), header->value().size());
+
+    const ResponseEncoder *best = &json();
+    double bestQuality = 0;
+    for (const auto &entry : m_entries)
+    {
+        for (const auto &mediaType : entry.mediaTypes)
+        {
+            double q = quality(accept, mediaType);
+            if (q > bestQuality)
+            {
+                best = entry.encoder.get();
+                bestQuality = q;
+            }
+        }
+    }
+    return *best;
+}
+
+double ResponseEncoders::quality(std::string_view accept, std::string_view mediaType)
+{
+    std::string_view type = mediaType.substr(0, mediaType.find('/'));
+
+    // Exact types beat type/* which beats */*, whatever the order in Accept
+    int bestSpecificity = 0;
+    double q = 0;
+    while (!accept.empty())
+    {
+        std::size_t comma = accept.find(',');
+        std::string_view range = accept.substr(0, comma);
+        accept = comma == std::string_view::npos ? std::string_view() : accept.substr(comma + 1);
+
+        std::size_t semicolon = range.find(';');
+        std::string_view name = trim(range.substr(0, semicolon));
+        std::string_view parameters = semicolon == std::string_view::npos ? std::string_view() : range.substr(semicolon + 1);
+
+        int specificity = 0;
+        if (equalsIgnoreCase(name, mediaType))
+        {
+            specificity = 3;
+        }
+        else if (name.size() == type.size() + 2 && equalsIgnoreCase(name.substr(0, type.size()), type) &&
+                 name.substr(type.size()) == "/*")
+        {
+            specificity = 2;
+        }
+        else if (name == "*/*")
+        {
+            specificity = 1;
+        }
+        if (specificity <= bestSpecificity)
+        {
+            continue;
+        }
+
+        double rangeQuality = 1;
+        while (!parameters.empty())
+        {
+            semicolon = parameters.find(';');
+            std::string_view parameter = trim(parameters.substr(0, semicolon));
+            parameters = semicolon == std::string_view::npos ? std::string_view() : parameters.substr(semicolon + 1);
+            if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=')
+            {
+                rangeQuality = std::strtod(std::string(parameter.substr(2)).c_str(), nullptr);
+            }
+        }
+        bestSpecificity = specificity;
+        q = rangeQuality;
+    }
+    return q;
+}
+
+void ResponseEncoders::write(const ResponseEncoder &encoder, http::response<http::string_body> &res, const nlohmann::json &value)
+{
+    auto mediaType = encoder.mediaType();
+    res.set(http::field::content_type, boost::beast::string_view(mediaType.data(), mediaType.size()));
+    res.set(http::field::vary, "Accept");
+    res.body() = encoder.encode(value);
+}
+
+void ResponseEncoders::write(const http::request<http::string_body> &req, http::response<http::string_body> &res, const nlohmann::json &value)
+{
+    write(getInstance().negotiate(req), res, value);
+}
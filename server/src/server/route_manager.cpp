@@ -1,81 +1,209 @@
 #include <server/route_manager.hpp>
 #include <utils/logger.hpp>
-#include <sstream>
+#include <algorithm>
+#include <stdexcept>
 #include <iostream>
 
-std::map<std::string, std::map<std::string, RouteHandler>> RouteManager::routes;
+RouteManager::RouteNode RouteManager::root;
 
-void RouteManager::addRoute(const std::string &path, const std::string &method, RouteHandler handler)
+bool RouteParams::add(std::string_view name, std::string_view value)
 {
-    std::string finalPath = path;
-    finalPath = std::regex_replace(path, std::regex("\\{([^}]*)\\}"), "([^/]*)");
-    finalPath = "^" + path + "$";
-    finalPath = "/api" + path;
-    routes[finalPath][method] = handler;
-    Logger::info({"Registered route: " + method + " " + finalPath});
+    if (m_size == capacity)
+    {
+        return false;
+    }
+    m_params[m_size++] = {name, value};
+    return true;
 }
 
-bool RouteManager::handleRequest(
-    const http::request<http::string_body> &req,
-    http::response<http::string_body> &res)
+std::string_view RouteParams::get(std::string_view name) const
 {
-    auto [path, queryString] = splitPathAndQuery(std::string(req.target()));
-    std::string method = std::string(req.method_string());
-    Logger::debug({"Handling request: " + method + " " + path + " with query: " + queryString});
+    for (std::size_t i = 0; i < m_size; i++)
+    {
+        if (m_params[i].first == name)
+        {
+            return m_params[i].second;
+        }
+    }
+    return {};
+}
+
+bool RouteParams::contains(std::string_view name) const
+{
+    for (std::size_t i = 0; i < m_size; i++)
+    {
+        if (m_params[i].first == name)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // First try exact match
-    if (routes.count(path) > 0 && routes[path].count(method) > 0)
+RouteManager::RouteEntry &RouteManager::insert(const std::string &path, const std::string &method)
+{
+    http::verb verb = http::string_to_verb(method);
+    if (verb == http::verb::unknown)
     {
-        routes[path][method](req, res);
-        return true;
+        throw std::invalid_argument("Unknown HTTP method: " + method);
     }
 
-    // Try pattern matching for paths with parameters
-    for (const auto &route : routes)
+    RouteNode *node = &root;
+    std::string_view remaining = path;
+    while (!remaining.empty())
     {
-        std::regex pattern(route.first);
-        if (std::regex_match(path, pattern))
+        size_t end = remaining.find('/');
+        std::string_view segment = remaining.substr(0, end);
+        remaining = end == std::string_view::npos ? std::string_view() : remaining.substr(end + 1);
+        if (segment.empty())
         {
-            if (route.second.count(method) > 0)
+            continue;
+        }
+
+        if (segment.front() == '{' && segment.back() == '}')
+        {
+            std::string name(segment.substr(1, segment.size() - 2));
+            if (!node->paramChild)
+            {
+                node->paramChild = std::make_unique<RouteNode>();
+                node->paramChild->paramName = name;
+            }
+            else if (node->paramChild->paramName != name)
             {
-                route.second.at(method)(req, res);
-                return true;
+                Logger::warn({"Route " + path + " renames parameter {" + node->paramChild->paramName + "} to {" + name + "}, keeping the first name"});
             }
+            node = node->paramChild.get();
+            continue;
+        }
+
+        auto child = std::lower_bound(node->children.begin(), node->children.end(), segment,
+                                      [](const auto &entry, std::string_view key)
+                                      { return entry.first < key; });
+        if (child == node->children.end() || child->first != segment)
+        {
+            child = node->children.emplace(child, std::string(segment), std::make_unique<RouteNode>());
         }
+        node = child->second.get();
     }
 
-    return false;
+    for (auto &entry : node->entries)
+    {
+        if (entry.method == verb)
+        {
+            return entry;
+        }
+    }
+    node->entries.push_back({verb, nullptr, nullptr});
+    return node->entries.back();
 }
 
-std::pair<std::string, std::string> RouteManager::splitPathAndQuery(const std::string &target)
+void RouteManager::addRoute(const std::string &path, const std::string &method, RouteHandler handler)
 {
-    size_t pos = target.find('?');
-    if (pos == std::string::npos)
-    {
-        return {target, ""};
-    }
-    return {target.substr(0, pos - 1), target.substr(pos + 1)};
+    addRoute(path, method, ParamRouteHandler(
+                               [handler](const http::request<http::string_body> &req, http::response<http::string_body> &res, const RouteParams &)
+                               { handler(req, res); }));
+}
+
+void RouteManager::addRoute(const std::string &path, const std::string &method, ParamRouteHandler handler)
+{
+    std::string finalPath = "/api" + path;
+    insert(finalPath, method).handler = std::move(handler);
+    Logger::info({"Registered route: " + method + " " + finalPath});
 }
 
-QueryParams RouteManager::parseQueryParameters(const std::string &queryString)
+void RouteManager::addAsyncRoute(const std::string &path, const std::string &method, AsyncRouteHandler handler)
 {
-    QueryParams params;
-    std::stringstream ss(queryString);
-    std::string pair;
+    std::string finalPath = "/api" + path;
+    insert(finalPath, method).asyncHandler = std::move(handler);
+    Logger::info({"Registered async route: " + method + " " + finalPath});
+}
 
-    while (std::getline(ss, pair, '&'))
+const RouteManager::RouteEntry *RouteManager::match(const RouteNode &node, std::string_view path, http::verb method, RouteParams &params)
+{
+    while (!path.empty() && path.front() == '/')
     {
-        if (pair.empty())
-            continue;
+        path.remove_prefix(1);
+    }
+    if (path.empty())
+    {
+        for (const auto &entry : node.entries)
+        {
+            if (entry.method == method)
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t end = path.find('/');
+    std::string_view segment = path.substr(0, end);
+    std::string_view rest = end == std::string_view::npos ? std::string_view() : path.substr(end);
+
+    // Static segments win over parameters; fall back to the parameter branch
+    // if the static branch has no route for this path and method.
+    auto child = std::lower_bound(node.children.begin(), node.children.end(), segment,
+                                  [](const auto &entry, std::string_view key)
+                                  { return entry.first < key; });
+    if (child != node.children.end() && child->first == segment)
+    {
+        if (const RouteEntry *found = match(*child->second, rest, method, params))
+        {
+            return found;
+        }
+    }
 
-        size_t pos = pair.find('=');
-        if (pos != std::string::npos)
+    if (node.paramChild)
+    {
+        size_t mark = params.size();
+        if (params.add(node.paramChild->paramName, segment))
         {
-            std::string key = pair.substr(0, pos);
-            std::string value = pair.substr(pos + 1);
-            params[key] = value;
+            if (const RouteEntry *found = match(*node.paramChild, rest, method, params))
+            {
+                return found;
+            }
         }
+        params.truncate(mark);
+    }
+
+    return nullptr;
+}
+
+const RouteManager::RouteEntry *RouteManager::find(const http::request<http::string_body> &req, RouteParams &params)
+{
+    std::string_view target(req.target().data(), req.target().size());
+    std::string_view path = target.substr(0, target.find('?'));
+
+    return match(root, path, req.method(), params);
+}
+
+bool RouteManager::handleRequestAsync(
+    const http::request<http::string_body> &req,
+    http::response<http::string_body> &res,
+    AsyncDone done)
+{
+    RouteParams params;
+    const RouteEntry *entry = find(req, params);
+    if (!entry || !entry->asyncHandler)
+    {
+        return false;
+    }
+
+    entry->asyncHandler(req, res, params, std::move(done));
+    return true;
+}
+
+bool RouteManager::handleRequest(
+    const http::request<http::string_body> &req,
+    http::response<http::string_body> &res)
+{
+    RouteParams params;
+    const RouteEntry *entry = find(req, params);
+    if (!entry || !entry->handler)
+    {
+        return false;
     }
 
-    return params;
+    entry->handler(req, res, params);
+    return true;
 }
@@ -0,0 +1,242 @@
+#include <server/websocket_session.hpp>
+#include <config/app_config.hpp>
+#include <utils/logger.hpp>
+#include <nlohmann/json.hpp>
+#include <boost/asio/post.hpp>
+#include <algorithm>
+#include <cctype>
+
+using json = nlohmann::json;
+
+WebSocketSession::WebSocketSession(beast::tcp_stream &&stream, int document_id)
+    : ws_(std::move(stream)), document_id_(document_id) {}
+
+int WebSocketSession::collaboration_target(beast::string_view target)
+{
+    constexpr beast::string_view prefix = "/documents/";
+    constexpr beast::string_view suffix = "/collaborate";
+
+    target = target.substr(0, target.find('?'));
+    if (target.size() <= prefix.size() + suffix.size() ||
+        target.substr(0, prefix.size()) != prefix ||
+        target.substr(target.size() - suffix.size()) != suffix)
+    {
+        return -1;
+    }
+
+    auto id = target.substr(prefix.size(), target.size() - prefix.size() - suffix.size());
+    if (id.size() > 9 || !std::all_of(id.begin(), id.end(), [](unsigned char c)
+                                      { return std::isdigit(c); }))
+    {
+        return -1;
+    }
+    return std::stoi(std::string(id));
+}
+
+void WebSocketSession::start(http::request<http::string_body> request)
+{
+    // The WebSocket layer keeps the connection alive with pings, so the HTTP
+    // keep-alive deadline no longer applies
+    beast::get_lowest_layer(ws_).expires_never();
+    ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+    ws_.set_option(websocket::stream_base::decorator(
+        [](websocket::response_type &response)
+        {
+            response.set(http::field::server, "Boost Beast Server");
+        }));
+    ws_.read_message_max(AppConfig::getInstance().getMaxRequestBodySize());
+
+    auto self = shared_from_this();
+    ws_.async_accept(request,
+                     [self](beast::error_code ec)
+                     {
+                         self->on_accept(ec);
+                     });
+}
+
+void WebSocketSession::on_accept(beast::error_code ec)
+{
+    if (ec)
+    {
+        Logger::debug({"WebSocket handshake failed: " + ec.message()});
+        return;
+    }
+
+    try
+    {
+        room_ = CollaborationManager::getInstance().open(document_id_);
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to open collaboration room: " + std::string(e.what())});
+        do_close();
+        return;
+    }
+
+    Logger::debug({"Client joined collaboration on document " + std::to_string(document_id_)});
+    room_->join(shared_from_this());
+    read_message();
+}
+
+void WebSocketSession::read_message()
+{
+    auto self = shared_from_this();
+    ws_.async_read(buffer_,
+                   [self](beast::error_code ec, std::size_t bytes_transferred)
+                   {
+                       self->on_read(ec);
+                   });
+}
+
+void WebSocketSession::on_read(beast::error_code ec)
+{
+    if (ec)
+    {
+        if (ec != websocket::error::closed)
+        {
+            Logger::debug({"Error reading WebSocket message: " + ec.message()});
+        }
+        closed_ = true;
+        drop_queued();
+        leave_room();
+        return;
+    }
+
+    std::string text = beast::buffers_to_string(buffer_.data());
+    buffer_.consume(buffer_.size());
+    handle_message(text);
+
+    read_message();
+}
+
+void WebSocketSession::handle_message(const std::string &text)
+{
+    if (!room_)
+    {
+        return;
+    }
+
+    try
+    {
+        auto message = json::parse(text);
+        std::string type = message.at("type").get<std::string>();
+        if (type != "operation")
+        {
+            throw std::invalid_argument("Unknown message type: " + type);
+        }
+        room_->submit(shared_from_this(),
+                      message.at("revision").get<uint64_t>(),
+                      OperationalTransform::fromJson(message.at("operations")));
+    }
+    catch (const std::exception &e)
+    {
+        send(std::make_shared<const std::string>(json{{"type", "error"}, {"message", e.what()}}.dump()));
+    }
+}
+
+void WebSocketSession::send(std::shared_ptr<const std::string> message)
+{
+    net::post(ws_.get_executor(),
+              [self = shared_from_this(), message = std::move(message)]()
+              {
+                  if (self->closed_)
+                  {
+                      return;
+                  }
+                  // A client that cannot keep up would otherwise grow the
+                  // queue without bound; it reconnects and gets a snapshot
+                  if (self->queue_.size() >= AppConfig::getInstance().getWebSocketMaxQueuedMessages())
+                  {
+                      Logger::warn({"Closing slow collaboration client on document " + std::to_string(self->document_id_)});
+                      self->do_close();
+                      return;
+                  }
+                  self->queue_.push_back(message);
+                  if (self->queue_.size() == 1)
+                  {
+                      self->write_message();
+                  }
+              });
+}
+
+void WebSocketSession::close()
+{
+    net::post(ws_.get_executor(),
+              [self = shared_from_this()]()
+              {
+                  self->do_close();
+              });
+}
+
+void WebSocketSession::write_message()
+{
+    auto self = shared_from_this();
+    ws_.text(true);
+    ws_.async_write(net::buffer(*queue_.front()),
+                    [self](beast::error_code ec, std::size_t bytes_transferred)
+                    {
+                        self->on_write(ec);
+                    });
+}
+
+void WebSocketSession::on_write(beast::error_code ec)
+{
+    if (ec)
+    {
+        // The pending read fails as well and leaves the room
+        Logger::debug({"Error writing WebSocket message: " + ec.message()});
+        closed_ = true;
+    }
+
+    if (closed_)
+    {
+        queue_.clear();
+        return;
+    }
+
+    queue_.pop_front();
+    if (!queue_.empty())
+    {
+        write_message();
+    }
+}
+
+void WebSocketSession::do_close()
+{
+    if (closed_)
+    {
+        return;
+    }
+    closed_ = true;
+    drop_queued();
+
+    // Beast allows a close alongside a pending write; the read loop ends
+    // once the peer answers and then leaves the room
+    auto self = shared_from_this();
+    ws_.async_close(websocket::close_code::normal,
+                    [self](beast::error_code ec)
+                    {
+                        if (ec)
+                        {
+                            Logger::debug({"Error closing WebSocket: " + ec.message()});
+                        }
+                    });
+}
+
+void WebSocketSession::drop_queued()
+{
+    // The front message is being written and must outlive the write
+    if (!queue_.empty())
+    {
+        queue_.erase(queue_.begin() + 1, queue_.end());
+    }
+}
+
+void WebSocketSession::leave_room()
+{
+    if (room_)
+    {
+        room_->leave(shared_from_this());
+        room_.reset();
+    }
+}
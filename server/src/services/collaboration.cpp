@@ -0,0 +1,739 @@
+#include <services/collaboration.hpp>
+#include <config/app_config.hpp>
+#include <db/db_executor.hpp>
+#include <models/document_history.hpp>
+#include <utils/logger.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+namespace
+{
+    using Operations = OperationalTransform::Operations;
+
+    TextOperation insertOperation(long long position, std::string text)
+    {
+        return TextOperation{TextOperation::Type::Insert, position, std::move(text), 0};
+    }
+
+    TextOperation deleteOperation(long long position, long long length)
+    {
+        return TextOperation{TextOperation::Type::Delete, position, "", length};
+    }
+
+    long long textLength(const TextOperation &operation)
+    {
+        return static_cast<long long>(Rope::utf8Length(operation.text));
+    }
+
+    // Where a position ends up once [start, start + length) has been deleted
+    long long afterDelete(long long position, long long start, long long length)
+    {
+        if (position <= start)
+        {
+            return position;
+        }
+        return position >= start + length ? position - length : start;
+    }
+
+    // Appends a delete of [from, to), or nothing when the range is empty
+    void appendDelete(Operations &operations, long long from, long long to)
+    {
+        if (to > from)
+        {
+            operations.push_back(deleteOperation(from, to - from));
+        }
+    }
+
+    void append(Operations &target, const Operations &source)
+    {
+        target.insert(target.end(), source.begin(), source.end());
+    }
+
+    // Throws std::out_of_range when an operation does not fit the text
+    void applyTo(Rope &text, const Operations &operations)
+    {
+        for (const auto &operation : operations)
+        {
+            if (operation.type == TextOperation::Type::Insert)
+            {
+                text.insert(operation.position, operation.text);
+            }
+            else
+            {
+                text.erase(operation.position, operation.length);
+            }
+        }
+    }
+
+    // Merges runs of typing and of forward/backward deleting so a flush
+    // issues as few overlay() levels as possible
+    Operations compact(const Operations &operations)
+    {
+        Operations result;
+        for (const auto &operation : operations)
+        {
+            if (!result.empty() && result.back().type == operation.type)
+            {
+                auto &last = result.back();
+                if (operation.type == TextOperation::Type::Insert &&
+                    operation.position == last.position + textLength(last))
+                {
+                    last.text += operation.text;
+                    continue;
+                }
+                if (operation.type == TextOperation::Type::Delete && operation.position == last.position)
+                {
+                    last.length += operation.length;
+                    continue;
+                }
+                if (operation.type == TextOperation::Type::Delete &&
+                    operation.position + operation.length == last.position)
+                {
+                    last.position = operation.position;
+                    last.length += operation.length;
+                    continue;
+                }
+            }
+            if (operation.type == TextOperation::Type::Delete && operation.length == 0)
+            {
+                continue;
+            }
+            result.push_back(operation);
+        }
+        return result;
+    }
+}
+
+std::pair<Operations, Operations> OperationalTransform::transformPair(const TextOperation &a, const TextOperation &b)
+{
+    using Type = TextOperation::Type;
+    Operations first;
+    Operations second;
+
+    if (a.type == Type::Insert && b.type == Type::Insert)
+    {
+        // b wins ties, so its text ends up before a's
+        if (a.position < b.position)
+        {
+            first.push_back(a);
+            second.push_back(insertOperation(b.position + textLength(a), b.text));
+        }
+        else
+        {
+            first.push_back(insertOperation(a.position + textLength(b), a.text));
+            second.push_back(b);
+        }
+    }
+    else if (a.type == Type::Insert)
+    {
+        long long end = b.position + b.length;
+        if (a.position <= b.position)
+        {
+            first.push_back(a);
+            second.push_back(deleteOperation(b.position + textLength(a), b.length));
+        }
+        else if (a.position >= end)
+        {
+            first.push_back(insertOperation(a.position - b.length, a.text));
+            second.push_back(b);
+        }
+        else
+        {
+            // Text typed inside a range someone else deleted survives; the
+            // delete is split around it
+            first.push_back(insertOperation(b.position, a.text));
+            appendDelete(second, b.position, a.position);
+            appendDelete(second, b.position + textLength(a), b.position + textLength(a) + end - a.position);
+        }
+    }
+    else if (b.type == Type::Insert)
+    {
+        auto [transformedB, transformedA] = transformPair(b, a);
+        first = std::move(transformedA);
+        second = std::move(transformedB);
+    }
+    else
+    {
+        // Overlapping deletes only remove the overlap once
+        appendDelete(first, afterDelete(a.position, b.position, b.length),
+                     afterDelete(a.position + a.length, b.position, b.length));
+        appendDelete(second, afterDelete(b.position, a.position, a.length),
+                     afterDelete(b.position + b.length, a.position, a.length));
+    }
+
+    return {std::move(first), std::move(second)};
+}
+
+std::pair<Operations, Operations> OperationalTransform::transform(const Operations &a, const Operations &b)
+{
+    if (a.empty() || b.empty())
+    {
+        return {a, b};
+    }
+    if (a.size() == 1 && b.size() == 1)
+    {
+        return transformPair(a.front(), b.front());
+    }
+
+    // Walk one side an operation at a time; transformPair may split a delete,
+    // so either side can grow as it goes.
+    if (a.size() == 1)
+    {
+        Operations transformedA = a;
+        Operations transformedB;
+        for (const auto &operation : b)
+        {
+            auto [nextA, pieceB] = transform(transformedA, Operations{operation});
+            transformedA = std::move(nextA);
+            append(transformedB, pieceB);
+        }
+        return {std::move(transformedA), std::move(transformedB)};
+    }
+
+    Operations transformedA;
+    Operations transformedB = b;
+    for (const auto &operation : a)
+    {
+        auto [pieceA, nextB] = transform(Operations{operation}, transformedB);
+        append(transformedA, pieceA);
+        transformedB = std::move(nextB);
+    }
+    return {std::move(transformedA), std::move(transformedB)};
+}
+
+Operations OperationalTransform::fromJson(const json &operations)
+{
+    if (!operations.is_array())
+    {
+        throw std::invalid_argument("Expected an operations array");
+    }
+
+    Operations result;
+    result.reserve(operations.size());
+    for (const auto &item : operations)
+    {
+        TextOperation operation;
+        std::string type = item.at("type").get<std::string>();
+        operation.position = item.at("position").get<long long>();
+        operation.length = 0;
+        if (type == "insert")
+        {
+            operation.type = TextOperation::Type::Insert;
+            operation.text = item.at("text").get<std::string>();
+        }
+        else if (type == "delete")
+        {
+            operation.type = TextOperation::Type::Delete;
+            operation.length = item.at("length").get<long long>();
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown operation type: " + type);
+        }
+        if (operation.position < 0 || operation.length < 0)
+        {
+            throw std::invalid_argument("Operation positions and lengths must not be negative");
+        }
+        result.push_back(std::move(operation));
+    }
+    return result;
+}
+
+json OperationalTransform::toJson(const Operations &operations)
+{
+    json result = json::array();
+    for (const auto &operation : operations)
+    {
+        if (operation.type == TextOperation::Type::Insert)
+        {
+            result.push_back({{"type", "insert"}, {"position", operation.position}, {"text", operation.text}});
+        }
+        else
+        {
+            result.push_back({{"type", "delete"}, {"position", operation.position}, {"length", operation.length}});
+        }
+    }
+    return result;
+}
+
+// CollaborationRoom Implementation
+CollaborationRoom::CollaborationRoom(net::io_context &ioContext, int documentId)
+    : m_strand(net::make_strand(ioContext)), m_timer(m_strand), m_documentId(documentId) {}
+
+void CollaborationRoom::join(std::shared_ptr<CollaborationClient> client)
+{
+    net::post(m_strand, [self = shared_from_this(), client]()
+              {
+                  self->m_clients.push_back(client);
+                  if (self->m_loaded)
+                  {
+                      client->send(self->snapshot());
+                  }
+                  else
+                  {
+                      self->load();
+                  } });
+}
+
+void CollaborationRoom::leave(const std::shared_ptr<CollaborationClient> &client)
+{
+    net::post(m_strand, [self = shared_from_this(), client]()
+              {
+                  auto &clients = self->m_clients;
+                  clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+                  CollaborationManager::getInstance().close(self->m_documentId);
+                  self->closeIfIdle(); });
+}
+
+void CollaborationRoom::submit(std::shared_ptr<CollaborationClient> client, uint64_t revision, Operations operations)
+{
+    net::post(m_strand, [self = shared_from_this(), client, revision, operations = std::move(operations)]() mutable
+              {
+                  if (!self->m_loaded)
+                  {
+                      // A snapshot is on its way; the client starts over from it
+                      self->sendError(client, "Document is being reloaded");
+                      return;
+                  }
+                  self->apply(client, revision, std::move(operations)); });
+}
+
+void CollaborationRoom::load()
+{
+    if (m_loading)
+    {
+        return;
+    }
+    m_loading = true;
+
+    auto self = shared_from_this();
+    bool queued = DatabaseExecutor::getInstance().post(
+        [self]()
+        {
+            std::shared_ptr<Document> document;
+            bool failed = false;
+            try
+            {
+                document = Document::findById(self->m_documentId);
+            }
+            catch (const std::exception &e)
+            {
+                Logger::error({"Failed to load document " + std::to_string(self->m_documentId) +
+                               " for collaboration: " + std::string(e.what())});
+                failed = true;
+            }
+            net::post(self->m_strand, [self, document, failed]()
+                      { self->loaded(document, failed); });
+        });
+
+    if (!queued)
+    {
+        m_loading = false;
+        schedule();
+    }
+}
+
+void CollaborationRoom::loaded(std::shared_ptr<Document> document, bool failed)
+{
+    m_loading = false;
+
+    if (failed)
+    {
+        schedule();
+        return;
+    }
+
+    if (!document)
+    {
+        auto message = std::make_shared<const std::string>(
+            json{{"type", "error"}, {"message", "Document not found"}}.dump());
+        for (const auto &client : m_clients)
+        {
+            client->send(message);
+            client->close();
+        }
+        m_clients.clear();
+        closeIfIdle();
+        return;
+    }
+
+    // Revisions keep counting across reloads, so anything based on the old
+    // text is recognisably older than the history that is left
+    m_loaded = true;
+    m_content = Rope(document->getContent());
+    m_persistedVersion = document->getVersion();
+    m_history.clear();
+    m_historyStart = m_revision;
+
+    auto message = snapshot();
+    for (const auto &client : m_clients)
+    {
+        client->send(message);
+    }
+    closeIfIdle();
+}
+
+std::shared_ptr<const std::string> CollaborationRoom::snapshot() const
+{
+    return std::make_shared<const std::string>(
+        json{{"type", "snapshot"}, {"revision", m_revision}, {"content", m_content.str()}}.dump());
+}
+
+void CollaborationRoom::sendError(const std::shared_ptr<CollaborationClient> &client, const std::string &message)
+{
+    client->send(std::make_shared<const std::string>(json{{"type", "error"}, {"message", message}}.dump()));
+}
+
+void CollaborationRoom::broadcast(const json &message, const CollaborationClient *except)
+{
+    auto text = std::make_shared<const std::string>(message.dump());
+    for (const auto &client : m_clients)
+    {
+        if (client.get() != except)
+        {
+            client->send(text);
+        }
+    }
+}
+
+void CollaborationRoom::apply(const std::shared_ptr<CollaborationClient> &client, uint64_t revision, Operations operations)
+{
+    if (revision < m_historyStart || revision > m_revision)
+    {
+        sendError(client, "Revision " + std::to_string(revision) + " is no longer available");
+        client->send(snapshot());
+        return;
+    }
+
+    for (auto batch = m_history.begin() + static_cast<std::ptrdiff_t>(revision - m_historyStart); batch != m_history.end(); ++batch)
+    {
+        operations = OperationalTransform::transform(operations, *batch).first;
+    }
+
+    // Apply to a copy so a bad batch leaves the text untouched
+    Rope edited = m_content;
+    try
+    {
+        applyTo(edited, operations);
+    }
+    catch (const std::out_of_range &e)
+    {
+        sendError(client, e.what());
+        client->send(snapshot());
+        return;
+    }
+
+    m_content = std::move(edited);
+    record(operations);
+    m_unsaved.insert(m_unsaved.end(), operations.begin(), operations.end());
+
+    client->send(std::make_shared<const std::string>(json{{"type", "ack"}, {"revision", m_revision}}.dump()));
+    broadcast({{"type", "operation"}, {"revision", m_revision}, {"operations", OperationalTransform::toJson(operations)}},
+              client.get());
+    schedule();
+}
+
+void CollaborationRoom::record(const Operations &operations)
+{
+    m_revision++;
+    m_history.push_back(operations);
+    std::size_t historyLimit = std::max<std::size_t>(1, AppConfig::getInstance().getCollaborationHistoryLimit());
+    while (m_history.size() > historyLimit)
+    {
+        m_history.pop_front();
+        m_historyStart++;
+    }
+}
+
+void CollaborationRoom::schedule()
+{
+    if (m_timerArmed)
+    {
+        return;
+    }
+    m_timerArmed = true;
+    m_timer.expires_after(std::chrono::milliseconds(AppConfig::getInstance().getCollaborationFlushIntervalMs()));
+    m_timer.async_wait(net::bind_executor(m_strand, [self = shared_from_this()](boost::system::error_code ec)
+                                          {
+                                              self->m_timerArmed = false;
+                                              if (!ec)
+                                              {
+                                                  self->onTimer();
+                                              } }));
+}
+
+void CollaborationRoom::onTimer()
+{
+    if (m_loaded)
+    {
+        flush();
+    }
+    else if (!m_clients.empty())
+    {
+        load();
+    }
+    else
+    {
+        closeIfIdle();
+    }
+}
+
+void CollaborationRoom::flush()
+{
+    if (m_flushing || m_unsaved.empty())
+    {
+        return;
+    }
+
+    auto operations = std::make_shared<const Operations>(compact(m_unsaved));
+    if (operations->empty())
+    {
+        m_unsaved.clear();
+        closeIfIdle();
+        return;
+    }
+
+    auto self = shared_from_this();
+    int baseVersion = m_persistedVersion;
+    bool queued = DatabaseExecutor::getInstance().post(
+        [self, operations, baseVersion]()
+        {
+            int version = baseVersion;
+            std::size_t saved = 0;
+            std::exception_ptr error;
+            try
+            {
+                // Each call commits on its own, so a failure part way keeps
+                // the version of the last chunk that made it
+                while (saved < operations->size())
+                {
+                    std::size_t count = std::min(Document::MAX_OPERATIONS, operations->size() - saved);
+                    Operations chunk(operations->begin() + saved, operations->begin() + saved + count);
+                    version = Document::applyOperations(self->m_documentId, version, chunk).getVersion();
+                    saved += count;
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            net::post(self->m_strand, [self, operations, version, saved, error]()
+                      { self->flushed(*operations, version, saved, error); });
+        });
+
+    if (!queued)
+    {
+        schedule();
+        return;
+    }
+    m_flushing = true;
+    m_unsaved.clear();
+}
+
+void CollaborationRoom::flushed(const Operations &operations, int version, std::size_t saved, std::exception_ptr error)
+{
+    m_flushing = false;
+    m_persistedVersion = version;
+
+    if (!error)
+    {
+        if (m_unsaved.empty())
+        {
+            closeIfIdle();
+        }
+        else
+        {
+            schedule();
+        }
+        return;
+    }
+
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const VersionConflict &)
+    {
+        Logger::warn({"Document " + std::to_string(m_documentId) +
+                      " was changed outside the collaboration session; rebasing unsaved edits"});
+
+        // Everything not yet saved, in order, against the persisted version
+        Operations pending(operations.begin() + static_cast<std::ptrdiff_t>(saved), operations.end());
+        append(pending, m_unsaved);
+        m_unsaved = std::move(pending);
+        rebase();
+        return;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to save collaborative edits to document " + std::to_string(m_documentId) + " after " +
+                       std::to_string(saved) + " operations: " + std::string(e.what())});
+    }
+    discardUnsaved();
+}
+
+// Fetches the stored document and the text of the version the unsaved edits
+// were made against; the difference between the two is what the other
+// writer changed.
+void CollaborationRoom::rebase()
+{
+    // Keeps flush() from saving against the outdated version meanwhile
+    m_flushing = true;
+
+    auto self = shared_from_this();
+    int baseVersion = m_persistedVersion;
+    bool queued = DatabaseExecutor::getInstance().post(
+        [self, baseVersion]()
+        {
+            std::shared_ptr<Document> document;
+            std::optional<Operations> remote;
+            try
+            {
+                document = Document::findById(self->m_documentId);
+                auto base = DocumentHistory::find(self->m_documentId, baseVersion);
+                if (document && base)
+                {
+                    remote = DocumentHistory::diff(base->content, document->getContent());
+                }
+            }
+            catch (const std::exception &e)
+            {
+                Logger::error({"Failed to load document " + std::to_string(self->m_documentId) +
+                               " for rebasing: " + std::string(e.what())});
+            }
+            net::post(self->m_strand, [self, document, remote = std::move(remote)]()
+                      { self->rebased(document, remote); });
+        });
+
+    if (!queued)
+    {
+        // The next flush conflicts again and retries
+        m_flushing = false;
+        schedule();
+    }
+}
+
+void CollaborationRoom::rebased(std::shared_ptr<Document> document, const std::optional<Operations> &remote)
+{
+    m_flushing = false;
+    if (!document || !remote)
+    {
+        discardUnsaved();
+        return;
+    }
+
+    // m_unsaved and remote both start from the base version: the first half
+    // of the transform is what to save on top of the stored text, the second
+    // is the other writer's change as the editors have to apply it
+    auto [pending, concurrent] = OperationalTransform::transform(m_unsaved, *remote);
+    Rope edited = m_content;
+    try
+    {
+        applyTo(edited, concurrent);
+    }
+    catch (const std::out_of_range &e)
+    {
+        Logger::error({"Failed to rebase collaborative edits to document " + std::to_string(m_documentId) + ": " +
+                       std::string(e.what())});
+        discardUnsaved();
+        return;
+    }
+
+    m_content = std::move(edited);
+    m_persistedVersion = document->getVersion();
+    m_unsaved = compact(pending);
+    if (!concurrent.empty())
+    {
+        record(concurrent);
+        broadcast({{"type", "operation"}, {"revision", m_revision}, {"operations", OperationalTransform::toJson(concurrent)}},
+                  nullptr);
+    }
+
+    if (m_unsaved.empty())
+    {
+        closeIfIdle();
+    }
+    else
+    {
+        schedule();
+    }
+}
+
+// The stored text is the only thing every party agrees on now: drop what
+// could not be saved, say so, and restart everyone from it
+void CollaborationRoom::discardUnsaved()
+{
+    m_unsaved.clear();
+    m_loaded = false;
+    if (m_clients.empty())
+    {
+        closeIfIdle();
+        return;
+    }
+    broadcast({{"type", "error"}, {"message", "Unsaved edits could not be saved and were discarded; reloading the document"}},
+              nullptr);
+    load();
+}
+
+void CollaborationRoom::closeIfIdle()
+{
+    if (m_clients.empty() && m_unsaved.empty() && !m_flushing && !m_loading)
+    {
+        CollaborationManager::getInstance().release(m_documentId, this);
+    }
+}
+
+// CollaborationManager Implementation
+void CollaborationManager::initialize(net::io_context &ioContext)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ioContext = &ioContext;
+}
+
+std::shared_ptr<CollaborationRoom> CollaborationManager::open(int documentId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_ioContext)
+    {
+        throw std::runtime_error("Collaboration is not initialized");
+    }
+
+    auto &entry = m_rooms[documentId];
+    if (!entry.room)
+    {
+        entry.room = std::make_shared<CollaborationRoom>(*m_ioContext, documentId);
+    }
+    entry.holders++;
+    return entry.room;
+}
+
+void CollaborationManager::close(int documentId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_rooms.find(documentId);
+    if (found != m_rooms.end() && found->second.holders > 0)
+    {
+        found->second.holders--;
+    }
+}
+
+void CollaborationManager::release(int documentId, const CollaborationRoom *room)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_rooms.find(documentId);
+    if (found != m_rooms.end() && found->second.room.get() == room && found->second.holders == 0)
+    {
+        m_rooms.erase(found);
+    }
+}
+
+std::size_t CollaborationManager::activeRooms()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rooms.size();
+}
@@ -0,0 +1,209 @@
+#include <services/document_cache.hpp>
+#include <utils/logger.hpp>
+#include <algorithm>
+
+void DocumentCache::initialize(std::size_t byteBudget, std::size_t shardCount)
+{
+    if (!m_shards.empty() || byteBudget == 0)
+    {
+        return;
+    }
+
+    shardCount = std::max<std::size_t>(1, shardCount);
+    m_shardBudget = byteBudget / shardCount;
+    m_shards.reserve(shardCount);
+    for (std::size_t i = 0; i < shardCount; i++)
+    {
+        m_shards.push_back(std::make_unique<Shard>());
+    }
+
+    Logger::info({"Document cache initialized with " + std::to_string(byteBudget) + " bytes over " +
+                  std::to_string(shardCount) + " shards"});
+}
+
+std::shared_ptr<Document> DocumentCache::get(int id)
+{
+    Shard *shard = shardFor(id);
+    if (!shard)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<const Document> document;
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        auto found = shard->index.find(id);
+        if (found == shard->index.end())
+        {
+            m_misses++;
+            return nullptr;
+        }
+        shard->entries.splice(shard->entries.begin(), shard->entries, found->second);
+        document = found->second->document;
+    }
+
+    m_hits++;
+    // Callers mutate what findById returns, so they get their own copy
+    return std::make_shared<Document>(*document);
+}
+
+uint64_t DocumentCache::generation(int id)
+{
+    Shard *shard = shardFor(id);
+    if (!shard)
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    return shard->generation;
+}
+
+void DocumentCache::fill(const Document &document, uint64_t generation)
+{
+    Shard *shard = shardFor(document.getId());
+    if (!shard)
+    {
+        return;
+    }
+    auto copy = snapshot(document);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if (shard->generation == generation)
+    {
+        insertLocked(*shard, std::move(copy));
+    }
+}
+
+void DocumentCache::put(const Document &document)
+{
+    Shard *shard = shardFor(document.getId());
+    if (!shard)
+    {
+        return;
+    }
+    auto copy = snapshot(document);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->generation++;
+    insertLocked(*shard, std::move(copy));
+}
+
+void DocumentCache::replace(const Document &document, uint64_t generation)
+{
+    Shard *shard = shardFor(document.getId());
+    if (!shard)
+    {
+        return;
+    }
+    auto copy = snapshot(document);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if (shard->generation++ == generation)
+    {
+        insertLocked(*shard, std::move(copy));
+    }
+    else
+    {
+        eraseLocked(*shard, document.getId());
+    }
+}
+
+void DocumentCache::invalidate(int id)
+{
+    Shard *shard = shardFor(id);
+    if (!shard)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->generation++;
+    eraseLocked(*shard, id);
+}
+
+void DocumentCache::clear()
+{
+    for (auto &shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->generation++;
+        shard->entries.clear();
+        shard->index.clear();
+        shard->bytes = 0;
+    }
+}
+
+CacheMetrics DocumentCache::getMetrics()
+{
+    CacheMetrics metrics;
+    metrics.byteBudget = m_shardBudget * m_shards.size();
+    for (auto &shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        metrics.bytes += shard->bytes;
+        metrics.entries += shard->entries.size();
+    }
+    metrics.hits = m_hits;
+    metrics.misses = m_misses;
+    metrics.evictions = m_evictions;
+    return metrics;
+}
+
+DocumentCache::Shard *DocumentCache::shardFor(int id)
+{
+    if (m_shards.empty() || id < 0)
+    {
+        return nullptr;
+    }
+    return m_shards[static_cast<std::size_t>(id) % m_shards.size()].get();
+}
+
+std::shared_ptr<const Document> DocumentCache::snapshot(const Document &document)
+{
+    // Copying shares the rope; flattening here, outside the shard lock, lets
+    // every copy handed out by get() serialise without flattening again.
+    auto copy = std::make_shared<const Document>(document);
+    copy->getContent();
+    return copy;
+}
+
+void DocumentCache::insertLocked(Shard &shard, std::shared_ptr<const Document> document)
+{
+    eraseLocked(shard, document->getId());
+
+    std::size_t bytes = footprint(*document);
+    if (bytes > m_shardBudget)
+    {
+        return;
+    }
+
+    while (shard.bytes + bytes > m_shardBudget && !shard.entries.empty())
+    {
+        const Entry &victim = shard.entries.back();
+        shard.bytes -= victim.bytes;
+        shard.index.erase(victim.id);
+        shard.entries.pop_back();
+        m_evictions++;
+    }
+
+    int id = document->getId();
+    shard.entries.push_front(Entry{id, std::move(document), bytes});
+    shard.index[id] = shard.entries.begin();
+    shard.bytes += bytes;
+}
+
+void DocumentCache::eraseLocked(Shard &shard, int id)
+{
+    auto found = shard.index.find(id);
+    if (found == shard.index.end())
+    {
+        return;
+    }
+    shard.bytes -= found->second->bytes;
+    shard.entries.erase(found->second);
+    shard.index.erase(found);
+}
+
+std::size_t DocumentCache::footprint(const Document &document)
+{
+    // Approximate: the object, title, rope plus flattened content and the
+    // list/map node overhead
+    return sizeof(Document) + sizeof(Entry) + 64 +
+           document.getTitle().size() + 2 * document.getContentBytes();
+}
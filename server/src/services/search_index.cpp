@@ -0,0 +1,803 @@
+#include <services/search_index.hpp>
+#include <db/db_manager.hpp>
+#include <db/prepared_statements.hpp>
+#include <db/query_params.hpp>
+#include <utils/logger.hpp>
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace
+{
+    constexpr double BM25_K1 = 1.2;
+    constexpr double BM25_B = 0.75;
+    // A title occurrence counts as this many content occurrences
+    constexpr uint32_t TITLE_WEIGHT = 2;
+    constexpr std::size_t MAX_TERM_LENGTH = 64;
+    constexpr std::size_t BUILD_BATCH_SIZE = 500;
+    constexpr std::size_t MIN_TOMBSTONES_FOR_COMPACTION = 1024;
+
+    constexpr uint32_t SNAPSHOT_MAGIC = 0x49534554; // "TESI"
+    constexpr uint32_t SNAPSHOT_VERSION = 2;
+    constexpr uint32_t NO_ORDINAL = std::numeric_limits<uint32_t>::max();
+
+    void appendVarint(std::vector<uint8_t> &out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t readVarint(const uint8_t *&cursor)
+    {
+        uint32_t value = 0;
+        int shift = 0;
+        while (*cursor & 0x80)
+        {
+            value |= static_cast<uint32_t>(*cursor++ & 0x7f) << shift;
+            shift += 7;
+        }
+        value |= static_cast<uint32_t>(*cursor++) << shift;
+        return value;
+    }
+
+    // Calls visit(ordinal, frequency) for every entry of a posting list
+    template <typename Visitor>
+    void forEachPosting(const std::vector<uint8_t> &bytes, Visitor visit)
+    {
+        const uint8_t *cursor = bytes.data();
+        const uint8_t *end = cursor + bytes.size();
+        uint32_t ordinal = 0;
+        while (cursor < end)
+        {
+            ordinal += readVarint(cursor);
+            uint32_t frequency = readVarint(cursor);
+            visit(ordinal, frequency);
+        }
+    }
+
+    void appendPosting(std::vector<uint8_t> &bytes, uint32_t &lastOrdinal, uint32_t ordinal, uint32_t frequency)
+    {
+        appendVarint(bytes, bytes.empty() ? ordinal : ordinal - lastOrdinal);
+        appendVarint(bytes, frequency);
+        lastOrdinal = ordinal;
+    }
+
+    template <typename T>
+    void writeValue(std::ostream &out, const T &value)
+    {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void writeString(std::ostream &out, const std::string &value)
+    {
+        writeValue(out, static_cast<uint32_t>(value.size()));
+        out.write(value.data(), value.size());
+    }
+
+    template <typename T>
+    T readValue(std::istream &in)
+    {
+        T value{};
+        if (!in.read(reinterpret_cast<char *>(&value), sizeof(value)))
+        {
+            throw std::runtime_error("Truncated search index snapshot");
+        }
+        return value;
+    }
+
+    std::string readString(std::istream &in)
+    {
+        std::string value(readValue<uint32_t>(in), '\0');
+        if (!in.read(value.data(), value.size()))
+        {
+            throw std::runtime_error("Truncated search index snapshot");
+        }
+        return value;
+    }
+
+    std::string formatScore(float score)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.9g", score);
+        return buffer;
+    }
+}
+
+void SearchIndex::initialize(const std::string &snapshotPath)
+{
+    bool restored = false;
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        if (m_ready)
+        {
+            return;
+        }
+
+        m_snapshotPath = snapshotPath;
+        restored = loadSnapshot();
+        if (!restored)
+        {
+            buildFromDatabase();
+        }
+    }
+
+    // Takes the lock itself, only while applying what it found
+    if (restored)
+    {
+        reconcileWithDatabase();
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        m_ready = true;
+
+        Logger::info({"Search index ready with " + std::to_string(m_ordinals.size()) + " documents and " +
+                      std::to_string(m_terms.size()) + " terms" + (restored ? " (from snapshot)" : "")});
+    }
+
+    if (!restored)
+    {
+        saveSnapshot();
+    }
+}
+
+bool SearchIndex::isReady() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_ready;
+}
+
+void SearchIndex::index(const Document &document)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (!m_ready || document.getId() == -1)
+    {
+        return;
+    }
+    indexLocked(document);
+}
+
+void SearchIndex::remove(int id)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (!m_ready)
+    {
+        return;
+    }
+    removeLocked(id);
+}
+
+void SearchIndex::assignAuthor(int id, int authorId, int version, time_t updatedAt)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (!m_ready)
+    {
+        return;
+    }
+    auto found = m_ordinals.find(id);
+    if (found != m_ordinals.end())
+    {
+        DocumentEntry &entry = m_documents[found->second];
+        entry.authorId = authorId;
+        entry.version = version;
+        entry.updatedAt = updatedAt;
+    }
+}
+
+void SearchIndex::refresh(int id)
+{
+    if (!isReady())
+    {
+        return;
+    }
+
+    std::optional<Document> doc;
+    {
+        auto conn = DatabaseManager::getInstance().getConnection();
+        auto statement = conn.prepare(PreparedStatements::DOCUMENTS_INDEX_BY_IDS);
+        pqxx::work txn(*conn);
+        auto result = txn.exec_prepared(statement, toPgArray({id}));
+        txn.commit();
+        if (!result.empty())
+        {
+            doc = fromIndexRow(result[0]);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (!doc)
+    {
+        removeLocked(id);
+        return;
+    }
+    indexIfNewerLocked(*doc);
+}
+
+void SearchIndex::reconcile()
+{
+    if (isReady())
+    {
+        reconcileWithDatabase();
+    }
+}
+
+DocumentPage SearchIndex::search(
+    const std::string &query, int author_id, bool includePrivate, int limit, const std::string &cursor) const
+{
+    // Same cursor format as Document::search: "<score>_<id>"
+    std::optional<float> cursorScore;
+    int cursorId = 0;
+    if (!cursor.empty())
+    {
+        size_t separator = cursor.rfind('_');
+        if (separator == std::string::npos || separator == 0)
+        {
+            throw std::invalid_argument("Invalid search cursor");
+        }
+        cursorScore = std::stof(cursor.substr(0, separator));
+        cursorId = std::stoi(cursor.substr(separator + 1));
+    }
+
+    auto tokens = tokenize(query);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    DocumentPage page;
+    if (!m_ready || m_ordinals.empty() || limit <= 0)
+    {
+        return page;
+    }
+
+    const double documentCount = static_cast<double>(m_ordinals.size());
+    const double averageLength = std::max(1.0, static_cast<double>(m_totalLength) / documentCount);
+
+    std::unordered_map<uint32_t, double> scores;
+    for (const auto &token : tokens)
+    {
+        auto term = m_termIds.find(token);
+        if (term == m_termIds.end())
+        {
+            continue;
+        }
+        const PostingList &postings = m_postings[term->second];
+        if (postings.documentFrequency == 0)
+        {
+            continue;
+        }
+
+        const double df = postings.documentFrequency;
+        const double idf = std::log(1.0 + (documentCount - df + 0.5) / (df + 0.5));
+        forEachPosting(postings.bytes, [&](uint32_t ordinal, uint32_t frequency)
+                       {
+            const DocumentEntry &entry = m_documents[ordinal];
+            if (!entry.live ||
+                (author_id != -1 && entry.authorId != author_id) ||
+                (!includePrivate && !entry.isPublic))
+            {
+                return;
+            }
+            const double norm = BM25_K1 * (1.0 - BM25_B + BM25_B * entry.length / averageLength);
+            scores[ordinal] += idf * frequency * (BM25_K1 + 1.0) / (frequency + norm); });
+    }
+
+    // Scores are compared as floats so that they survive the cursor round-trip
+    std::vector<std::pair<float, uint32_t>> ranked;
+    ranked.reserve(scores.size());
+    for (const auto &[ordinal, score] : scores)
+    {
+        float rounded = static_cast<float>(score);
+        int id = m_documents[ordinal].id;
+        if (cursorScore && !(rounded < *cursorScore || (rounded == *cursorScore && id < cursorId)))
+        {
+            continue;
+        }
+        ranked.emplace_back(rounded, ordinal);
+    }
+
+    auto better = [this](const std::pair<float, uint32_t> &a, const std::pair<float, uint32_t> &b)
+    {
+        if (a.first != b.first)
+        {
+            return a.first > b.first;
+        }
+        return m_documents[a.second].id > m_documents[b.second].id;
+    };
+    std::size_t count = std::min<std::size_t>(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), better);
+
+    page.documents.reserve(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const DocumentEntry &entry = m_documents[ranked[i].second];
+        Document doc(entry.title, "", "");
+        doc.id = entry.id;
+        doc.author_id = entry.authorId;
+        doc.is_public = entry.isPublic;
+        doc.created_at = entry.createdAt;
+        doc.updated_at = entry.updatedAt;
+        doc.version = entry.version;
+        page.documents.push_back(doc);
+    }
+    if (count == static_cast<std::size_t>(limit))
+    {
+        page.nextCursor = formatScore(ranked[count - 1].first) + "_" + std::to_string(page.documents.back().getId());
+    }
+    return page;
+}
+
+bool SearchIndex::saveSnapshot()
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (!m_ready || m_snapshotPath.empty())
+    {
+        return false;
+    }
+
+    try
+    {
+        compactLocked();
+
+        std::filesystem::path path(m_snapshotPath);
+        if (path.has_parent_path())
+        {
+            std::filesystem::create_directories(path.parent_path());
+        }
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                throw std::runtime_error("Cannot open " + temporary.string());
+            }
+
+            writeValue(out, SNAPSHOT_MAGIC);
+            writeValue(out, SNAPSHOT_VERSION);
+            writeValue(out, m_totalLength);
+
+            writeValue(out, static_cast<uint32_t>(m_documents.size()));
+            for (const auto &entry : m_documents)
+            {
+                writeValue(out, static_cast<int32_t>(entry.id));
+                writeValue(out, entry.length);
+                writeValue(out, static_cast<int32_t>(entry.authorId));
+                writeValue(out, static_cast<uint8_t>(entry.isPublic));
+                writeValue(out, static_cast<int64_t>(entry.createdAt));
+                writeValue(out, static_cast<int64_t>(entry.updatedAt));
+                writeValue(out, static_cast<int32_t>(entry.version));
+                writeString(out, entry.title);
+                writeValue(out, static_cast<uint32_t>(entry.terms.size()));
+                for (uint32_t term : entry.terms)
+                {
+                    writeValue(out, term);
+                }
+            }
+
+            writeValue(out, static_cast<uint32_t>(m_terms.size()));
+            for (std::size_t i = 0; i < m_terms.size(); i++)
+            {
+                const PostingList &postings = m_postings[i];
+                writeString(out, m_terms[i]);
+                writeValue(out, postings.lastOrdinal);
+                writeValue(out, postings.documentFrequency);
+                writeValue(out, static_cast<uint32_t>(postings.bytes.size()));
+                out.write(reinterpret_cast<const char *>(postings.bytes.data()), postings.bytes.size());
+            }
+
+            if (!out.flush())
+            {
+                throw std::runtime_error("Failed writing " + temporary.string());
+            }
+        }
+
+        std::filesystem::rename(temporary, path);
+        Logger::info({"Search index snapshot written to " + m_snapshotPath});
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Failed to write search index snapshot: " + std::string(e.what())});
+        return false;
+    }
+}
+
+void SearchIndex::indexLocked(const Document &document)
+{
+    removeLocked(document.getId());
+
+    std::unordered_map<std::string, uint32_t> frequencies;
+    uint32_t length = 0;
+    for (auto &token : tokenize(document.getTitle()))
+    {
+        frequencies[std::move(token)] += TITLE_WEIGHT;
+        length++;
+    }
+    for (auto &token : tokenize(document.getContent()))
+    {
+        frequencies[std::move(token)] += 1;
+        length++;
+    }
+
+    const uint32_t ordinal = static_cast<uint32_t>(m_documents.size());
+    DocumentEntry entry;
+    entry.id = document.getId();
+    entry.length = length;
+    entry.live = true;
+    entry.title = document.getTitle();
+    entry.authorId = document.getAuthorId();
+    entry.isPublic = document.isPublic();
+    entry.createdAt = document.getCreatedAt();
+    entry.updatedAt = document.getUpdatedAt();
+    entry.version = document.getVersion();
+    entry.terms.reserve(frequencies.size());
+
+    for (auto &[token, frequency] : frequencies)
+    {
+        auto term = m_termIds.find(token);
+        if (term == m_termIds.end())
+        {
+            term = m_termIds.emplace(token, static_cast<uint32_t>(m_terms.size())).first;
+            m_terms.push_back(token);
+            m_postings.emplace_back();
+        }
+
+        PostingList &postings = m_postings[term->second];
+        appendPosting(postings.bytes, postings.lastOrdinal, ordinal, frequency);
+        postings.documentFrequency++;
+        entry.terms.push_back(term->second);
+    }
+
+    m_documents.push_back(std::move(entry));
+    m_ordinals[document.getId()] = ordinal;
+    m_totalLength += length;
+}
+
+// Loads run outside the lock, so a write indexed meanwhile, or another load
+// of the same document, may already have brought it further
+void SearchIndex::indexIfNewerLocked(const Document &document)
+{
+    auto found = m_ordinals.find(document.getId());
+    if (found != m_ordinals.end() && m_documents[found->second].version >= document.version)
+    {
+        return;
+    }
+    indexLocked(document);
+}
+
+void SearchIndex::removeLocked(int id)
+{
+    auto found = m_ordinals.find(id);
+    if (found == m_ordinals.end())
+    {
+        return;
+    }
+
+    DocumentEntry &entry = m_documents[found->second];
+    for (uint32_t term : entry.terms)
+    {
+        m_postings[term].documentFrequency--;
+    }
+    m_totalLength -= entry.length;
+    entry.live = false;
+    entry.title.clear();
+    entry.terms = {};
+    m_ordinals.erase(found);
+    m_tombstones++;
+
+    if (m_tombstones >= MIN_TOMBSTONES_FOR_COMPACTION && m_tombstones > m_ordinals.size())
+    {
+        compactLocked();
+    }
+}
+
+// Drops tombstoned documents and unused terms, renumbering both densely
+void SearchIndex::compactLocked()
+{
+    if (m_tombstones == 0)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> ordinalMap(m_documents.size(), NO_ORDINAL);
+    std::vector<DocumentEntry> documents;
+    documents.reserve(m_ordinals.size());
+    for (std::size_t i = 0; i < m_documents.size(); i++)
+    {
+        if (m_documents[i].live)
+        {
+            ordinalMap[i] = static_cast<uint32_t>(documents.size());
+            documents.push_back(std::move(m_documents[i]));
+        }
+    }
+
+    std::vector<uint32_t> termMap(m_terms.size(), NO_ORDINAL);
+    std::vector<std::string> terms;
+    std::vector<PostingList> postings;
+    std::unordered_map<std::string, uint32_t> termIds;
+    for (std::size_t i = 0; i < m_terms.size(); i++)
+    {
+        if (m_postings[i].documentFrequency == 0)
+        {
+            continue;
+        }
+
+        PostingList compacted;
+        compacted.documentFrequency = m_postings[i].documentFrequency;
+        forEachPosting(m_postings[i].bytes, [&](uint32_t ordinal, uint32_t frequency)
+                       {
+            if (ordinalMap[ordinal] != NO_ORDINAL)
+            {
+                appendPosting(compacted.bytes, compacted.lastOrdinal, ordinalMap[ordinal], frequency);
+            } });
+        compacted.bytes.shrink_to_fit();
+
+        termMap[i] = static_cast<uint32_t>(terms.size());
+        termIds.emplace(m_terms[i], termMap[i]);
+        terms.push_back(std::move(m_terms[i]));
+        postings.push_back(std::move(compacted));
+    }
+
+    m_ordinals.clear();
+    for (std::size_t i = 0; i < documents.size(); i++)
+    {
+        for (auto &term : documents[i].terms)
+        {
+            term = termMap[term];
+        }
+        m_ordinals[documents[i].id] = static_cast<uint32_t>(i);
+    }
+
+    m_documents = std::move(documents);
+    m_terms = std::move(terms);
+    m_postings = std::move(postings);
+    m_termIds = std::move(termIds);
+    m_tombstones = 0;
+}
+
+void SearchIndex::buildFromDatabase()
+{
+    auto conn = DatabaseManager::getInstance().getConnection();
+    auto statement = conn.prepare(PreparedStatements::DOCUMENTS_INDEX_BATCH);
+
+    int lastId = 0;
+    while (true)
+    {
+        pqxx::work txn(*conn);
+        auto result = txn.exec_prepared(statement, lastId, static_cast<int>(BUILD_BATCH_SIZE));
+        txn.commit();
+
+        for (auto row : result)
+        {
+            Document doc = fromIndexRow(row);
+            indexLocked(doc);
+            lastId = doc.id;
+        }
+
+        if (result.size() < BUILD_BATCH_SIZE)
+        {
+            break;
+        }
+    }
+}
+
+bool SearchIndex::loadSnapshot()
+{
+    std::ifstream in(m_snapshotPath, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+
+    try
+    {
+        if (readValue<uint32_t>(in) != SNAPSHOT_MAGIC || readValue<uint32_t>(in) != SNAPSHOT_VERSION)
+        {
+            throw std::runtime_error("Unrecognised search index snapshot format");
+        }
+        m_totalLength = readValue<uint64_t>(in);
+
+        uint32_t documentCount = readValue<uint32_t>(in);
+        m_documents.resize(documentCount);
+        for (uint32_t i = 0; i < documentCount; i++)
+        {
+            DocumentEntry &entry = m_documents[i];
+            entry.id = readValue<int32_t>(in);
+            entry.length = readValue<uint32_t>(in);
+            entry.authorId = readValue<int32_t>(in);
+            entry.isPublic = readValue<uint8_t>(in) != 0;
+            entry.createdAt = static_cast<time_t>(readValue<int64_t>(in));
+            entry.updatedAt = static_cast<time_t>(readValue<int64_t>(in));
+            entry.version = readValue<int32_t>(in);
+            entry.title = readString(in);
+            entry.live = true;
+            entry.terms.resize(readValue<uint32_t>(in));
+            for (auto &term : entry.terms)
+            {
+                term = readValue<uint32_t>(in);
+            }
+            m_ordinals[entry.id] = i;
+        }
+
+        uint32_t termCount = readValue<uint32_t>(in);
+        m_terms.reserve(termCount);
+        m_postings.resize(termCount);
+        for (uint32_t i = 0; i < termCount; i++)
+        {
+            m_terms.push_back(readString(in));
+            m_termIds.emplace(m_terms.back(), i);
+            PostingList &postings = m_postings[i];
+            postings.lastOrdinal = readValue<uint32_t>(in);
+            postings.documentFrequency = readValue<uint32_t>(in);
+            postings.bytes.resize(readValue<uint32_t>(in));
+            if (!in.read(reinterpret_cast<char *>(postings.bytes.data()), postings.bytes.size()))
+            {
+                throw std::runtime_error("Truncated search index snapshot");
+            }
+        }
+
+        for (const auto &entry : m_documents)
+        {
+            for (uint32_t term : entry.terms)
+            {
+                if (term >= termCount)
+                {
+                    throw std::runtime_error("Corrupt search index snapshot");
+                }
+            }
+        }
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::warn({"Ignoring search index snapshot: " + std::string(e.what())});
+        m_termIds.clear();
+        m_terms.clear();
+        m_postings.clear();
+        m_documents.clear();
+        m_ordinals.clear();
+        m_totalLength = 0;
+        m_tombstones = 0;
+        return false;
+    }
+}
+
+Document SearchIndex::fromIndexRow(const pqxx::row &row)
+{
+    Document doc(row["title"].as<std::string>(), row["content"].as<std::string>(""), "");
+    doc.id = row["id"].as<int>();
+    doc.author_id = row["author_id"].as<int>(-1);
+    doc.is_public = row["is_public"].as<bool>(false);
+    doc.created_at = row["created_at"].as<long long>(0);
+    doc.updated_at = row["updated_at"].as<long long>(0);
+    doc.version = row["version"].as<int>(1);
+    return doc;
+}
+
+// Brings the index up to date with changes it missed, while the server was
+// down or the change listener was disconnected, comparing versions rather
+// than reindexing everything. The queries run without the lock so searches
+// and writes carry on; it is only held to apply each batch.
+void SearchIndex::reconcileWithDatabase()
+{
+    std::unordered_map<int, int> indexed;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        indexed.reserve(m_ordinals.size());
+        for (const auto &[id, ordinal] : m_ordinals)
+        {
+            indexed.emplace(id, m_documents[ordinal].version);
+        }
+    }
+
+    auto conn = DatabaseManager::getInstance().getConnection();
+    auto versionsStatement = conn.prepare(PreparedStatements::DOCUMENT_INDEX_VERSIONS);
+    auto byIdsStatement = conn.prepare(PreparedStatements::DOCUMENTS_INDEX_BY_IDS);
+
+    pqxx::work txn(*conn);
+    auto versions = txn.exec_prepared(versionsStatement);
+
+    std::unordered_set<int> present;
+    std::vector<int> stale;
+    for (auto row : versions)
+    {
+        int id = row["id"].as<int>();
+        int version = row["version"].as<int>(1);
+        present.insert(id);
+
+        auto found = indexed.find(id);
+        if (found == indexed.end() || found->second != version)
+        {
+            stale.push_back(id);
+        }
+    }
+
+    // Documents indexed after the copy above are not in it, so nothing
+    // written meanwhile is removed here
+    std::vector<int> deleted;
+    for (const auto &[id, version] : indexed)
+    {
+        if (present.count(id) == 0)
+        {
+            deleted.push_back(id);
+        }
+    }
+    if (!deleted.empty())
+    {
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        for (int id : deleted)
+        {
+            removeLocked(id);
+        }
+    }
+
+    for (std::size_t offset = 0; offset < stale.size(); offset += BUILD_BATCH_SIZE)
+    {
+        std::vector<int> batch(stale.begin() + offset,
+                               stale.begin() + std::min(stale.size(), offset + BUILD_BATCH_SIZE));
+        auto result = txn.exec_prepared(byIdsStatement, toPgArray(batch));
+        std::vector<Document> documents;
+        documents.reserve(result.size());
+        for (auto row : result)
+        {
+            documents.push_back(fromIndexRow(row));
+        }
+
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        for (const auto &doc : documents)
+        {
+            indexIfNewerLocked(doc);
+        }
+    }
+    txn.commit();
+
+    Logger::info({"Search index reconciled: " + std::to_string(stale.size()) + " reindexed, " +
+                  std::to_string(deleted.size()) + " removed"});
+}
+
+// Lower-cased runs of ASCII letters and digits; bytes of multi-byte UTF-8
+// sequences are kept as part of the word.
+std::vector<std::string> SearchIndex::tokenize(std::string_view text)
+{
+    std::vector<std::string> tokens;
+    std::string current;
+    auto flush = [&]()
+    {
+        if (!current.empty() && current.size() <= MAX_TERM_LENGTH)
+        {
+            tokens.push_back(current);
+        }
+        current.clear();
+    };
+
+    for (unsigned char c : text)
+    {
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)
+        {
+            current.push_back(static_cast<char>(c));
+        }
+        else if (c >= 'A' && c <= 'Z')
+        {
+            current.push_back(static_cast<char>(c - 'A' + 'a'));
+        }
+        else
+        {
+            flush();
+        }
+    }
+    flush();
+    return tokens;
+}
@@ -0,0 +1,147 @@
+#include <utils/json_writer.hpp>
+
+void JsonWriter::separate()
+{
+    if (m_afterKey)
+    {
+        m_afterKey = false;
+        return;
+    }
+    if (!m_empty.empty())
+    {
+        if (!m_empty.back())
+        {
+            m_out.push_back(',');
+        }
+        m_empty.back() = false;
+    }
+}
+
+JsonWriter &JsonWriter::beginObject()
+{
+    separate();
+    m_out.push_back('{');
+    m_empty.push_back(true);
+    return *this;
+}
+
+JsonWriter &JsonWriter::endObject()
+{
+    m_empty.pop_back();
+    m_out.push_back('}');
+    return *this;
+}
+
+JsonWriter &JsonWriter::beginArray()
+{
+    separate();
+    m_out.push_back('[');
+    m_empty.push_back(true);
+    return *this;
+}
+
+JsonWriter &JsonWriter::endArray()
+{
+    m_empty.pop_back();
+    m_out.push_back(']');
+    return *this;
+}
+
+JsonWriter &JsonWriter::key(std::string_view name)
+{
+    separate();
+    m_out.push_back('"');
+    escape(m_out, name);
+    m_out.append("\":");
+    m_afterKey = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(std::string_view text)
+{
+    beginString();
+    escape(m_out, text);
+    return endString();
+}
+
+JsonWriter &JsonWriter::value(bool flag)
+{
+    separate();
+    m_out.append(flag ? "true" : "false");
+    return *this;
+}
+
+JsonWriter &JsonWriter::null()
+{
+    separate();
+    m_out.append("null");
+    return *this;
+}
+
+JsonWriter &JsonWriter::beginString()
+{
+    separate();
+    m_out.push_back('"');
+    return *this;
+}
+
+JsonWriter &JsonWriter::appendString(std::string_view piece)
+{
+    escape(m_out, piece);
+    return *this;
+}
+
+JsonWriter &JsonWriter::endString()
+{
+    m_out.push_back('"');
+    return *this;
+}
+
+void JsonWriter::escape(std::string &out, std::string_view text)
+{
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    // Copy runs of plain bytes in one append; only quotes, backslashes and
+    // control characters need rewriting
+    std::size_t run = 0;
+    for (std::size_t i = 0; i < text.size(); i++)
+    {
+        auto c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c)
+        {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\b':
+            out.append("\\b");
+            break;
+        case '\f':
+            out.append("\\f");
+            break;
+        case '\n':
+            out.append("\\n");
+            break;
+        case '\r':
+            out.append("\\r");
+            break;
+        case '\t':
+            out.append("\\t");
+            break;
+        default:
+            out.append("\\u00");
+            out.push_back(HEX[c >> 4]);
+            out.push_back(HEX[c & 0xf]);
+        }
+    }
+    out.append(text.data() + run, text.size() - run);
+}
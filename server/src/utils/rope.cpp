@@ -0,0 +1,274 @@
+#include <utils/rope.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    // Leaves are merged up to this size and text is chunked to it on build
+    constexpr std::size_t MAX_LEAF_BYTES = 2048;
+
+    bool isContinuationByte(char c)
+    {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    // Byte offset of the code point at position within a leaf
+    std::size_t byteOffset(const std::string &text, std::size_t position)
+    {
+        std::size_t offset = 0;
+        while (position > 0 && offset < text.size())
+        {
+            offset++;
+            while (offset < text.size() && isContinuationByte(text[offset]))
+            {
+                offset++;
+            }
+            position--;
+        }
+        return offset;
+    }
+}
+
+struct Rope::Node
+{
+    NodePtr left;
+    NodePtr right;
+    std::string text; // leaves only
+    std::size_t bytes = 0;
+    std::size_t chars = 0;
+    int height = 1;
+
+    bool isLeaf() const { return !left; }
+};
+
+Rope::Rope(std::string_view text) : m_root(build(text)) {}
+
+std::size_t Rope::length() const
+{
+    return m_root ? m_root->chars : 0;
+}
+
+std::size_t Rope::byteSize() const
+{
+    return m_root ? m_root->bytes : 0;
+}
+
+void Rope::insert(std::size_t position, std::string_view text)
+{
+    if (position > length())
+    {
+        throw std::out_of_range("Insert position " + std::to_string(position) + " is past the end of the text");
+    }
+    if (text.empty())
+    {
+        return;
+    }
+    auto [left, right] = split(m_root, position);
+    m_root = join(join(left, build(text)), right);
+}
+
+void Rope::erase(std::size_t position, std::size_t count)
+{
+    if (position > length() || count > length() - position)
+    {
+        throw std::out_of_range("Erase of " + std::to_string(count) + " characters at " +
+                                std::to_string(position) + " runs past the end of the text");
+    }
+    if (count == 0)
+    {
+        return;
+    }
+    auto [left, rest] = split(m_root, position);
+    auto right = split(rest, count).second;
+    m_root = join(left, right);
+}
+
+std::string Rope::str() const
+{
+    std::string text;
+    text.reserve(byteSize());
+
+    ChunkReader reader(*this);
+    std::string_view chunk;
+    while (reader.next(chunk))
+    {
+        text += chunk;
+    }
+    return text;
+}
+
+Rope::ChunkReader::ChunkReader(const Rope &rope) : m_root(rope.m_root), m_node(m_root.get()) {}
+
+bool Rope::ChunkReader::next(std::string_view &chunk)
+{
+    // In-order walk without recursion; depth is O(log n)
+    while (m_node || !m_stack.empty())
+    {
+        while (m_node)
+        {
+            m_stack.push_back(m_node);
+            m_node = m_node->left.get();
+        }
+        const Node *node = m_stack.back();
+        m_stack.pop_back();
+        m_node = node->right.get();
+        if (node->isLeaf())
+        {
+            chunk = node->text;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t Rope::utf8Length(std::string_view text)
+{
+    std::size_t count = 0;
+    for (char c : text)
+    {
+        if (!isContinuationByte(c))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+Rope::NodePtr Rope::build(std::string_view text)
+{
+    std::vector<NodePtr> level;
+    while (!text.empty())
+    {
+        std::size_t size = std::min(text.size(), MAX_LEAF_BYTES);
+        // Never cut a multi-byte sequence in half
+        while (size < text.size() && size > 0 && isContinuationByte(text[size]))
+        {
+            size--;
+        }
+        if (size == 0)
+        {
+            size = std::min(text.size(), MAX_LEAF_BYTES);
+        }
+        level.push_back(leaf(std::string(text.substr(0, size))));
+        text.remove_prefix(size);
+    }
+
+    // Pair up neighbours level by level into a perfectly balanced tree
+    while (level.size() > 1)
+    {
+        std::vector<NodePtr> next;
+        next.reserve((level.size() + 1) / 2);
+        for (std::size_t i = 0; i + 1 < level.size(); i += 2)
+        {
+            next.push_back(branch(level[i], level[i + 1]));
+        }
+        if (level.size() % 2 == 1)
+        {
+            next.push_back(level.back());
+        }
+        level = std::move(next);
+    }
+    return level.empty() ? nullptr : level.front();
+}
+
+Rope::NodePtr Rope::leaf(std::string text)
+{
+    auto node = std::make_shared<Node>();
+    node->bytes = text.size();
+    node->chars = utf8Length(text);
+    node->text = std::move(text);
+    return node;
+}
+
+Rope::NodePtr Rope::branch(NodePtr left, NodePtr right)
+{
+    auto node = std::make_shared<Node>();
+    node->bytes = left->bytes + right->bytes;
+    node->chars = left->chars + right->chars;
+    node->height = std::max(left->height, right->height) + 1;
+    node->left = std::move(left);
+    node->right = std::move(right);
+    return node;
+}
+
+int Rope::height(const NodePtr &node)
+{
+    return node ? node->height : 0;
+}
+
+// AVL rotation for subtrees whose heights differ by at most two
+Rope::NodePtr Rope::balance(NodePtr left, NodePtr right)
+{
+    if (height(left) > height(right) + 1)
+    {
+        if (height(left->left) >= height(left->right))
+        {
+            return branch(left->left, branch(left->right, std::move(right)));
+        }
+        return branch(branch(left->left, left->right->left),
+                      branch(left->right->right, std::move(right)));
+    }
+    if (height(right) > height(left) + 1)
+    {
+        if (height(right->right) >= height(right->left))
+        {
+            return branch(branch(std::move(left), right->left), right->right);
+        }
+        return branch(branch(std::move(left), right->left->left),
+                      branch(right->left->right, right->right));
+    }
+    return branch(std::move(left), std::move(right));
+}
+
+Rope::NodePtr Rope::join(const NodePtr &left, const NodePtr &right)
+{
+    if (!left)
+    {
+        return right;
+    }
+    if (!right)
+    {
+        return left;
+    }
+    if (left->isLeaf() && right->isLeaf() && left->bytes + right->bytes <= MAX_LEAF_BYTES)
+    {
+        return leaf(left->text + right->text);
+    }
+    if (left->height > right->height + 1)
+    {
+        return balance(left->left, join(left->right, right));
+    }
+    if (right->height > left->height + 1)
+    {
+        return balance(join(left, right->left), right->right);
+    }
+    return branch(left, right);
+}
+
+std::pair<Rope::NodePtr, Rope::NodePtr> Rope::split(const NodePtr &node, std::size_t position)
+{
+    if (!node)
+    {
+        return {nullptr, nullptr};
+    }
+    if (position == 0)
+    {
+        return {nullptr, node};
+    }
+    if (position >= node->chars)
+    {
+        return {node, nullptr};
+    }
+    if (node->isLeaf())
+    {
+        std::size_t offset = byteOffset(node->text, position);
+        return {leaf(node->text.substr(0, offset)), leaf(node->text.substr(offset))};
+    }
+    if (position < node->left->chars)
+    {
+        auto [left, right] = split(node->left, position);
+        return {left, join(right, node->right)};
+    }
+    auto [left, right] = split(node->right, position - node->left->chars);
+    return {join(node->left, left), right};
+}
@@ -2,8 +2,47 @@
 #include <vector>
 #include <utils/sqlbuilder.hpp>
 #include <utils/logger.hpp>
+#include <charconv>
 #include <stdexcept>
 
+namespace
+{
+    // Clause values arrive as text; numbers are bound as numbers so that the
+    // parameter types match the columns and LIMIT without server-side casts.
+    // Only canonical spellings are converted, so the value the server sees is
+    // exactly the text the caller passed and "007" stays a string.
+    sql_param typedParam(const std::string &value)
+    {
+        const char *begin = value.data();
+        const char *end = begin + value.size();
+        char buffer[32];
+
+        long long integer = 0;
+        auto parsed = std::from_chars(begin, end, integer);
+        if (parsed.ec == std::errc() && parsed.ptr == end)
+        {
+            auto printed = std::to_chars(buffer, buffer + sizeof(buffer), integer);
+            if (std::string(buffer, printed.ptr) == value)
+            {
+                return integer;
+            }
+            return value;
+        }
+
+        double number = 0;
+        parsed = std::from_chars(begin, end, number);
+        if (parsed.ec == std::errc() && parsed.ptr == end)
+        {
+            auto printed = std::to_chars(buffer, buffer + sizeof(buffer), number);
+            if (printed.ec == std::errc() && std::string(buffer, printed.ptr) == value)
+            {
+                return number;
+            }
+        }
+        return value;
+    }
+}
+
 SQLBuilder &SQLBuilder::select(const std::vector<std::string> &columns)
 {
     try
@@ -49,19 +88,15 @@ SQLBuilder &SQLBuilder::insert(const std::string &table, const std::vector<std::
             throw std::invalid_argument("No values specified for INSERT query");
         }
 
-        insertClause = "INSERT INTO " + table + " (";
-        for (const auto &column : columns)
-        {
-            insertClause += column + ", ";
-        }
-        insertClause = insertClause.substr(0, insertClause.length() - 2);
-        insertClause += ") VALUES (";
-        for (const auto &value : values)
+        if (columns.size() != values.size())
         {
-            insertClause += "'" + value + "', ";
+            Logger::error({"Column and value counts differ for INSERT query"});
+            throw std::invalid_argument("Column and value counts differ for INSERT query");
         }
-        insertClause = insertClause.substr(0, insertClause.length() - 2);
-        insertClause += ")";
+
+        insertTable = table;
+        insertColumns = columns;
+        insertValues = values;
 
         return *this;
     }
@@ -120,12 +155,7 @@ SQLBuilder &SQLBuilder::set(const std::vector<std::pair<std::string, std::string
             throw std::invalid_argument("No updates specified for SET clause");
         }
 
-        setClause = " SET ";
-        for (const auto &update : updates)
-        {
-            setClause += update.first + " = '" + update.second + "', ";
-        }
-        setClause = setClause.substr(0, setClause.length() - 2);
+        setUpdates = updates;
         return *this;
     }
     catch (const std::exception &e)
@@ -200,7 +230,7 @@ SQLBuilder &SQLBuilder::limit(const std::string &limit)
             Logger::error({"No limit specified for LIMIT clause"});
             throw std::invalid_argument("No limit specified for LIMIT clause");
         }
-        limitClause = " LIMIT " + limit;
+        limitValue = limit;
         return *this;
     }
     catch (const std::exception &e)
@@ -255,113 +285,160 @@ SQLBuilder &SQLBuilder::returning(const std::vector<std::string> &column)
     }
 }
 
-std::string SQLBuilder::build() const
+std::string SQLBuilder::renderValue(const std::string &value, std::vector<sql_param> *params, bool quote) const
 {
-    try
+    if (params)
     {
-        Logger::debug({"Building SQL query..."});
+        params->push_back(typedParam(value));
+        return "$" + std::to_string(params->size());
+    }
+    return quote ? "'" + value + "'" : value;
+}
 
-        if (isCustomQuery)
-        {
-            Logger::debug({"Using custom query: " + customQuery});
-            return customQuery;
-        }
+std::string SQLBuilder::renderWhere(std::vector<sql_param> *params) const
+{
+    if (whereConditions.empty())
+    {
+        return "";
+    }
 
-        std::string sql;
-        if (!insertClause.empty())
-        {
-            sql = insertClause;
-        }
-        else if (!deleteClause.empty())
+    std::string sql = " WHERE ";
+    bool firstGroup = true;
+
+    for (const auto &conditionGroup : whereConditions)
+    {
+        if (!firstGroup)
         {
-            sql = deleteClause;
+            sql += " AND ";
         }
-        else if (!updateClause.empty())
+        firstGroup = false;
+
+        bool firstCondition = true;
+        for (const auto &condition : conditionGroup)
         {
-            sql = updateClause;
-            if (setClause.empty())
+            if (!firstCondition)
             {
-                throw std::runtime_error("SET clause is required for update queries");
+                sql += " AND ";
             }
-            sql += setClause;
-        }
-        else
-        {
-            if (selectClause.empty())
+            firstCondition = false;
+
+            if (condition.op == "LIKE")
             {
-                throw std::runtime_error("SELECT clause is required for select queries");
+                sql += condition.column + " " + condition.op + " " + renderValue("%" + condition.value + "%", params);
             }
-            if (fromClause.empty())
+            else if (condition.op == "IN")
             {
-                throw std::runtime_error("FROM clause is required for select queries");
+                if (condition.values.empty())
+                {
+                    throw std::invalid_argument("No values specified for IN condition on " + condition.column);
+                }
+                std::string values = "(";
+                for (const auto &value : condition.values)
+                {
+                    values += renderValue(value, params, false) + ", ";
+                }
+                values = values.substr(0, values.length() - 2) + ")";
+                sql += condition.column + " " + condition.op + " " + values;
             }
-
-            sql = selectClause + fromClause;
-            if (!orderByClause.empty())
+            else if (condition.value == "true" || condition.value == "false")
             {
-                sql += orderByClause;
+                if (params)
+                {
+                    params->push_back(condition.value == "true");
+                    sql += condition.column + " " + condition.op + " $" + std::to_string(params->size());
+                }
+                else
+                {
+                    sql += condition.column + " " + condition.op + " " + condition.value;
+                }
             }
-            if (!limitClause.empty())
+            else
             {
-                sql += limitClause;
+                sql += condition.column + " " + condition.op + " " + renderValue(condition.value, params);
             }
         }
+    }
+
+    return sql;
+}
 
-        if (!returningClause.empty())
+std::string SQLBuilder::render(std::vector<sql_param> *params) const
+{
+    std::string sql;
+    if (!insertTable.empty())
+    {
+        sql = "INSERT INTO " + insertTable + " (";
+        for (const auto &column : insertColumns)
         {
-            sql += returningClause;
+            sql += column + ", ";
+        }
+        sql = sql.substr(0, sql.length() - 2) + ") VALUES (";
+        for (const auto &value : insertValues)
+        {
+            sql += renderValue(value, params) + ", ";
+        }
+        sql = sql.substr(0, sql.length() - 2) + ")";
+    }
+    else if (!deleteClause.empty())
+    {
+        sql = deleteClause + renderWhere(params);
+    }
+    else if (!updateClause.empty())
+    {
+        if (setUpdates.empty())
+        {
+            throw std::runtime_error("SET clause is required for update queries");
+        }
+        sql = updateClause + " SET ";
+        for (const auto &update : setUpdates)
+        {
+            sql += update.first + " = " + renderValue(update.second, params) + ", ";
+        }
+        sql = sql.substr(0, sql.length() - 2) + renderWhere(params);
+    }
+    else
+    {
+        if (selectClause.empty())
+        {
+            throw std::runtime_error("SELECT clause is required for select queries");
+        }
+        if (fromClause.empty())
+        {
+            throw std::runtime_error("FROM clause is required for select queries");
         }
 
-        if (!whereConditions.empty())
+        sql = selectClause + fromClause + renderWhere(params);
+        if (!orderByClause.empty())
+        {
+            sql += orderByClause;
+        }
+        if (!limitValue.empty())
         {
-            sql += " WHERE ";
-            bool firstGroup = true;
+            sql += " LIMIT " + renderValue(limitValue, params, false);
+        }
+    }
 
-            for (const auto &conditionGroup : whereConditions)
-            {
-                if (!firstGroup)
-                {
-                    sql += " AND ";
-                }
-                firstGroup = false;
+    if (!returningClause.empty())
+    {
+        sql += returningClause;
+    }
 
-                bool firstCondition = true;
-                for (const auto &condition : conditionGroup)
-                {
-                    if (!firstCondition)
-                    {
-                        sql += " AND ";
-                    }
-                    firstCondition = false;
-
-                    if (condition.op == "LIKE")
-                    {
-                        sql += condition.column + " " + condition.op + " '%" + condition.value + "%'";
-                    }
-                    else if (condition.op == "IN")
-                    {
-                        std::string values = "(";
-                        for (const auto &value : condition.values)
-                        {
-                            values += value + ", ";
-                        }
-                        values = values.substr(0, values.length() - 2) + ")";
-                        sql += condition.column + " " + condition.op + " " + values;
-                    }
-                    else
-                    {
-                        if (condition.value == "true" || condition.value == "false")
-                        {
-                            sql += condition.column + " " + condition.op + " " + condition.value;
-                        }
-                        else
-                        {
-                            sql += condition.column + " " + condition.op + " '" + condition.value + "'";
-                        }
-                    }
-                }
-            }
+    return sql;
+}
+
+std::string SQLBuilder::build() const
+{
+    try
+    {
+        Logger::debug({"Building SQL query..."});
+
+        if (isCustomQuery)
+        {
+            Logger::debug({"Using custom query: " + customQuery});
+            return customQuery;
         }
+
+        std::string sql = render(nullptr);
         Logger::debug({"Built SQL query: " + sql});
 
         return sql + ";";
@@ -369,6 +446,27 @@ std::string SQLBuilder::build() const
     catch (const std::exception &e)
     {
         Logger::error({"Error building SQL query: " + std::string(e.what())});
-        throw e;
+        throw;
+    }
+}
+
+parameterized_query SQLBuilder::buildParameterized() const
+{
+    try
+    {
+        if (isCustomQuery)
+        {
+            return {customQuery, {}};
+        }
+
+        parameterized_query query;
+        query.sql = render(&query.params);
+        Logger::debug({"Built parameterized SQL query: " + query.sql + " with " + std::to_string(query.params.size()) + " parameters"});
+        return query;
+    }
+    catch (const std::exception &e)
+    {
+        Logger::error({"Error building parameterized SQL query: " + std::string(e.what())});
+        throw;
     }
 }